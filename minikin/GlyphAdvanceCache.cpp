@@ -0,0 +1,469 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Minikin"
+
+#include "GlyphAdvanceCache.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "LruCache.h"
+
+#include <hb-ot.h>
+
+#include "HbFontCache.h"
+#include "MinikinFont.h"
+#include "MinikinInternal.h"
+
+namespace minikin {
+
+// Scripts whose OpenType lookups HarfBuzz may apply to simple text, including
+// the ones it falls back to when a font lacks the script of the text.
+static const hb_tag_t kSimpleScripts[] = {
+    HB_TAG('D', 'F', 'L', 'T'), HB_TAG('d', 'f', 'l', 't'),
+    HB_TAG('l', 'a', 't', 'n'), HB_TAG('h', 'a', 'n', 'i'),
+    HB_TAG('k', 'a', 'n', 'a'), HB_TAG_NONE};
+
+// Features HarfBuzz enables by default for horizontal left to right text,
+// other than kern.
+static const hb_tag_t kDefaultFeatures[] = {
+    HB_TAG('r', 'v', 'r', 'n'), HB_TAG('l', 't', 'r', 'a'),
+    HB_TAG('l', 't', 'r', 'm'), HB_TAG('c', 'c', 'm', 'p'),
+    HB_TAG('l', 'o', 'c', 'l'), HB_TAG('m', 'a', 'r', 'k'),
+    HB_TAG('m', 'k', 'm', 'k'), HB_TAG('r', 'l', 'i', 'g'),
+    HB_TAG('a', 'b', 'v', 'm'), HB_TAG('b', 'l', 'w', 'm'),
+    HB_TAG('c', 'a', 'l', 't'), HB_TAG('c', 'l', 'i', 'g'),
+    HB_TAG('c', 'u', 'r', 's'), HB_TAG('d', 'i', 's', 't'),
+    HB_TAG('l', 'i', 'g', 'a'), HB_TAG('r', 'c', 'l', 't'),
+    HB_TAG('t', 'r', 'a', 'k'), HB_TAG_NONE};
+
+static const hb_tag_t kKernFeature[] = {HB_TAG('k', 'e', 'r', 'n'),
+                                        HB_TAG_NONE};
+
+// Tables that make HarfBuzz shape with AAT or apply legacy kerning.
+static const hb_tag_t kUnsupportedTables[] = {
+    HB_TAG('m', 'o', 'r', 'x'), HB_TAG('m', 'o', 'r', 't'),
+    HB_TAG('k', 'e', 'r', 'x'), HB_TAG('t', 'r', 'a', 'k'),
+    HB_TAG('k', 'e', 'r', 'n'), HB_TAG_NONE};
+
+// Big-endian reads from a font table that fail instead of reading past its
+// end.
+class TableReader {
+ public:
+  explicit TableReader(hb_blob_t* blob) {
+    unsigned int length;
+    mData = reinterpret_cast<const uint8_t*>(hb_blob_get_data(blob, &length));
+    mSize = length;
+  }
+
+  bool readU16(size_t offset, uint16_t* value) const {
+    if (mData == nullptr || offset + 2 > mSize) {
+      return false;
+    }
+    *value = (mData[offset] << 8) | mData[offset + 1];
+    return true;
+  }
+
+  bool readU32(size_t offset, uint32_t* value) const {
+    uint16_t high, low;
+    if (!readU16(offset, &high) || !readU16(offset + 2, &low)) {
+      return false;
+    }
+    *value = (static_cast<uint32_t>(high) << 16) | low;
+    return true;
+  }
+
+ private:
+  const uint8_t* mData;
+  size_t mSize;
+};
+
+// Returns true if the GPOS lookup only adjusts the advance of the first glyph
+// of pairs of base glyphs. HarfBuzz then applies it to each pair of adjacent
+// glyphs independently.
+static bool isPairKerningLookup(const TableReader& gpos, unsigned int index) {
+  static const uint16_t kPairAdjustment = 2;
+  static const uint16_t kExtension = 9;
+  static const uint16_t kIgnoreBaseGlyphs = 0x0002;
+  static const uint16_t kXAdvance = 0x0004;
+
+  uint16_t lookupList, lookupOffset, type, flags, subtableCount;
+  if (!gpos.readU16(8, &lookupList) ||
+      !gpos.readU16(lookupList + 2 + 2 * index, &lookupOffset)) {
+    return false;
+  }
+  const size_t lookup = lookupList + lookupOffset;
+  if (!gpos.readU16(lookup, &type) || !gpos.readU16(lookup + 2, &flags) ||
+      !gpos.readU16(lookup + 4, &subtableCount) ||
+      (flags & kIgnoreBaseGlyphs) != 0) {
+    return false;
+  }
+  for (uint16_t i = 0; i < subtableCount; i++) {
+    uint16_t subtableOffset;
+    if (!gpos.readU16(lookup + 6 + 2 * i, &subtableOffset)) {
+      return false;
+    }
+    size_t subtable = lookup + subtableOffset;
+    uint16_t subtableType = type;
+    if (type == kExtension) {
+      uint32_t extensionOffset;
+      if (!gpos.readU16(subtable + 2, &subtableType) ||
+          !gpos.readU32(subtable + 4, &extensionOffset)) {
+        return false;
+      }
+      subtable += extensionOffset;
+    }
+    uint16_t valueFormat1, valueFormat2;
+    if (subtableType != kPairAdjustment ||
+        !gpos.readU16(subtable + 4, &valueFormat1) ||
+        !gpos.readU16(subtable + 6, &valueFormat2) ||
+        (valueFormat1 & ~kXAdvance) != 0 || valueFormat2 != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns true if a required feature is set for a script of simple text in
+// table. Required features apply whatever the enabled features are.
+static bool hasRequiredFeature(hb_face_t* face, hb_tag_t table) {
+  for (const hb_tag_t* script = kSimpleScripts; *script != HB_TAG_NONE;
+       script++) {
+    unsigned int scriptIndex, featureIndex;
+    if (!hb_ot_layout_table_find_script(face, table, *script, &scriptIndex)) {
+      continue;
+    }
+    if (hb_ot_layout_language_get_required_feature_index(
+            face, table, scriptIndex, HB_OT_LAYOUT_DEFAULT_LANGUAGE_INDEX,
+            &featureIndex)) {
+      return true;
+    }
+    const unsigned int languageCount = hb_ot_layout_script_get_language_tags(
+        face, table, scriptIndex, 0, nullptr, nullptr);
+    for (unsigned int language = 0; language < languageCount; language++) {
+      if (hb_ot_layout_language_get_required_feature_index(
+              face, table, scriptIndex, language, &featureIndex)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static bool hasLookups(hb_face_t* face,
+                       hb_tag_t table,
+                       const hb_tag_t* features) {
+  hb_set_t* lookups = hb_set_create();
+  hb_ot_layout_collect_lookups(face, table, kSimpleScripts, nullptr, features,
+                               lookups);
+  const bool found = !hb_set_is_empty(lookups);
+  hb_set_destroy(lookups);
+  return found || hasRequiredFeature(face, table);
+}
+
+// Returns the kern lookups of one language system of a script in GPOS.
+// hb_ot_layout_collect_lookups cannot select the default language system
+// alone, so the features are walked by index.
+static hb_set_t* collectKernLookups(hb_face_t* face,
+                                    unsigned int scriptIndex,
+                                    unsigned int languageIndex) {
+  hb_set_t* lookups = hb_set_create();
+  const unsigned int featureCount = hb_ot_layout_language_get_feature_indexes(
+      face, HB_OT_TAG_GPOS, scriptIndex, languageIndex, 0, nullptr, nullptr);
+  for (unsigned int i = 0; i < featureCount; i++) {
+    unsigned int featureIndex;
+    hb_tag_t tag;
+    unsigned int count = 1;
+    hb_ot_layout_language_get_feature_indexes(face, HB_OT_TAG_GPOS, scriptIndex,
+                                              languageIndex, i, &count,
+                                              &featureIndex);
+    count = 1;
+    hb_ot_layout_language_get_feature_tags(face, HB_OT_TAG_GPOS, scriptIndex,
+                                           languageIndex, i, &count, &tag);
+    if (tag != kKernFeature[0]) {
+      continue;
+    }
+    const unsigned int lookupCount = hb_ot_layout_feature_get_lookups(
+        face, HB_OT_TAG_GPOS, featureIndex, 0, nullptr, nullptr);
+    for (unsigned int j = 0; j < lookupCount; j++) {
+      unsigned int lookupIndex;
+      count = 1;
+      hb_ot_layout_feature_get_lookups(face, HB_OT_TAG_GPOS, featureIndex, j,
+                                       &count, &lookupIndex);
+      hb_set_add(lookups, lookupIndex);
+    }
+  }
+  return lookups;
+}
+
+// Returns true if every script and language system of simple text applies the
+// same kern lookups, all of them pair kerning.
+static bool hasOnlyPairKerning(hb_face_t* face) {
+  hb_set_t* all = hb_set_create();
+  hb_ot_layout_collect_lookups(face, HB_OT_TAG_GPOS, kSimpleScripts, nullptr,
+                               kKernFeature, all);
+  bool uniform = true;
+  for (const hb_tag_t* script = kSimpleScripts;
+       uniform && *script != HB_TAG_NONE; script++) {
+    unsigned int scriptIndex;
+    if (!hb_ot_layout_table_find_script(face, HB_OT_TAG_GPOS, *script,
+                                        &scriptIndex)) {
+      continue;
+    }
+    hb_set_t* lookups = collectKernLookups(
+        face, scriptIndex, HB_OT_LAYOUT_DEFAULT_LANGUAGE_INDEX);
+    uniform = hb_set_is_equal(lookups, all);
+    hb_set_destroy(lookups);
+
+    // Text may select any of the other language systems by its language.
+    const unsigned int languageCount = hb_ot_layout_script_get_language_tags(
+        face, HB_OT_TAG_GPOS, scriptIndex, 0, nullptr, nullptr);
+    for (unsigned int language = 0; uniform && language < languageCount;
+         language++) {
+      lookups = collectKernLookups(face, scriptIndex, language);
+      uniform = hb_set_is_equal(lookups, all);
+      hb_set_destroy(lookups);
+    }
+  }
+
+  hb_blob_t* blob = hb_face_reference_table(face, HB_OT_TAG_GPOS);
+  TableReader gpos(blob);
+  hb_codepoint_t lookup = HB_SET_VALUE_INVALID;
+  while (uniform && hb_set_next(all, &lookup)) {
+    uniform = isPairKerningLookup(gpos, lookup);
+  }
+  hb_blob_destroy(blob);
+  hb_set_destroy(all);
+  return uniform;
+}
+
+static SimpleShaping analyzeSimpleShaping(hb_face_t* face) {
+  for (const hb_tag_t* table = kUnsupportedTables; *table != HB_TAG_NONE;
+       table++) {
+    hb_blob_t* blob = hb_face_reference_table(face, *table);
+    const bool present = hb_blob_get_length(blob) != 0;
+    hb_blob_destroy(blob);
+    if (present) {
+      return kSimpleShapingUnsupported;
+    }
+  }
+  if (hasLookups(face, HB_OT_TAG_GSUB, kDefaultFeatures) ||
+      hasLookups(face, HB_OT_TAG_GPOS, kDefaultFeatures)) {
+    return kSimpleShapingUnsupported;
+  }
+  hb_set_t* kern = hb_set_create();
+  hb_ot_layout_collect_lookups(face, HB_OT_TAG_GPOS, kSimpleScripts, nullptr,
+                               kKernFeature, kern);
+  const bool hasKerning = !hb_set_is_empty(kern);
+  hb_set_destroy(kern);
+  if (!hasKerning) {
+    return kSimpleShapingPlain;
+  }
+  return hasOnlyPairKerning(face) ? kSimpleShapingPairKerning
+                                  : kSimpleShapingUnsupported;
+}
+
+// The advances and pair kerning of one font at one scale. Advances are kept
+// in pages of glyphs allocated on first use.
+class GlyphAdvanceTable {
+ public:
+  bool getAdvance(hb_font_t* hbFont,
+                  hb_codepoint_t glyph,
+                  hb_position_t* advance) {
+    const size_t page = glyph / kPageSize;
+    if (page >= mPages.size()) {
+      mPages.resize(page + 1);
+    }
+    if (!mPages[page]) {
+      mPages[page].reset(new hb_position_t[kPageSize]);
+      for (size_t i = 0; i < kPageSize; i++) {
+        mPages[page][i] = kUnknown;
+      }
+    }
+    hb_position_t& entry = mPages[page][glyph % kPageSize];
+    if (entry == kUnknown) {
+      hb_ot_layout_glyph_class_t glyphClass =
+          hb_ot_layout_get_glyph_class(hb_font_get_face(hbFont), glyph);
+      if (glyphClass == HB_OT_LAYOUT_GLYPH_CLASS_UNCLASSIFIED ||
+          glyphClass == HB_OT_LAYOUT_GLYPH_CLASS_BASE_GLYPH) {
+        entry = hb_font_get_glyph_h_advance(hbFont, glyph);
+      } else {
+        entry = kNotBase;
+      }
+    }
+    *advance = entry;
+    return entry != kNotBase;
+  }
+
+  hb_position_t getKerning(hb_font_t* hbFont,
+                           hb_buffer_t* buffer,
+                           uint16_t first,
+                           uint16_t second,
+                           hb_codepoint_t firstGlyph,
+                           hb_codepoint_t secondGlyph) {
+    const uint32_t key = (firstGlyph << 16) | (secondGlyph & 0xFFFF);
+    if (!mKerning) {
+      mKerning.reset(new LruCache<uint32_t, hb_position_t>(kMaxPairs));
+    }
+    const hb_position_t cached = mKerning->get(key);
+    if (cached != 0) {
+      return cached == kNoKerning ? 0 : cached;
+    }
+    // Pair kerning lookups act on each pair independently, so shaping the
+    // pair alone gives the adjustment it gets in any text.
+    const uint16_t pair[] = {first, second};
+    hb_buffer_clear_contents(buffer);
+    hb_buffer_add_utf16(buffer, pair, 2, 0, 2);
+    hb_buffer_guess_segment_properties(buffer);
+    hb_buffer_set_direction(buffer, HB_DIRECTION_LTR);
+    hb_shape(hbFont, buffer, nullptr, 0);
+    hb_position_t kerning = 0;
+    hb_position_t advance;
+    if (hb_buffer_get_length(buffer) == 2 &&
+        getAdvance(hbFont, firstGlyph, &advance)) {
+      kerning = hb_buffer_get_glyph_positions(buffer, nullptr)[0].x_advance -
+                advance;
+    }
+    const hb_position_t stored = kerning == 0 ? kNoKerning : kerning;
+    mKerning->put(key, stored);
+    return kerning;
+  }
+
+ private:
+  static const size_t kPageSize = 256;
+  static const size_t kMaxPairs = 4096;
+  static const hb_position_t kUnknown = INT32_MIN;
+  static const hb_position_t kNotBase = INT32_MAX;
+  // Stored for pairs without kerning, since the cache returns 0 for a miss.
+  static const hb_position_t kNoKerning = INT32_MIN;
+
+  std::vector<std::unique_ptr<hb_position_t[]>> mPages;
+  // Keyed by the first glyph in the high half and the second in the low half.
+  // Created with the first pair, fonts without kerning never need it.
+  std::unique_ptr<LruCache<uint32_t, hb_position_t>> mKerning;
+};
+
+class GlyphAdvanceCache : private OnEntryRemoved<uint64_t, GlyphAdvanceTable*> {
+ public:
+  GlyphAdvanceCache() : mCache(kMaxEntries), mBuffer(hb_buffer_create()) {
+    mCache.setOnEntryRemovedListener(this);
+  }
+
+  // callback for OnEntryRemoved
+  void operator()(uint64_t& /* key */, GlyphAdvanceTable*& value) {
+    delete value;
+  }
+
+  GlyphAdvanceTable* get(int32_t fontId, float xScale) {
+    uint32_t scaleBits;
+    memcpy(&scaleBits, &xScale, sizeof(scaleBits));
+    const uint64_t key =
+        (static_cast<uint64_t>(static_cast<uint32_t>(fontId)) << 32) |
+        scaleBits;
+    GlyphAdvanceTable* table = mCache.get(key);
+    if (table == nullptr) {
+      table = new GlyphAdvanceTable();
+      mCache.put(key, table);
+    }
+    return table;
+  }
+
+  SimpleShaping getSimpleShaping(const MinikinFont* minikinFont) {
+    const int32_t fontId = minikinFont->GetUniqueId();
+    auto it = mSimpleShaping.find(fontId);
+    if (it != mSimpleShaping.end()) {
+      return it->second;
+    }
+    SimpleShaping shaping = kSimpleShapingUnsupported;
+    hb_font_t* font = getHbFontLocked(minikinFont);
+    hb_face_t* face = hb_font_get_face(font);
+    if (face != nullptr) {
+      shaping = analyzeSimpleShaping(face);
+    }
+    hb_font_destroy(font);
+    mSimpleShaping[fontId] = shaping;
+    return shaping;
+  }
+
+  hb_buffer_t* buffer() { return mBuffer; }
+
+  // Advance tables of the font are left to age out of mCache.
+  void removeFont(int32_t fontId) { mSimpleShaping.erase(fontId); }
+
+  void clear() {
+    mCache.clear();
+    mSimpleShaping.clear();
+  }
+
+ private:
+  static const size_t kMaxEntries = 64;
+
+  LruCache<uint64_t, GlyphAdvanceTable*> mCache;
+  std::unordered_map<int32_t, SimpleShaping> mSimpleShaping;
+  // Used to shape kerning pairs.
+  hb_buffer_t* mBuffer;
+};
+
+static GlyphAdvanceCache* getGlyphAdvanceCacheLocked() {
+  assertMinikinLocked();
+  static GlyphAdvanceCache* cache = nullptr;
+  if (cache == nullptr) {
+    cache = new GlyphAdvanceCache();
+  }
+  return cache;
+}
+
+SimpleShaping getSimpleShapingLocked(const MinikinFont* minikinFont) {
+  return getGlyphAdvanceCacheLocked()->getSimpleShaping(minikinFont);
+}
+
+bool getGlyphAdvanceLocked(const MinikinFont* minikinFont,
+                           hb_font_t* hbFont,
+                           float xScale,
+                           hb_codepoint_t glyph,
+                           hb_position_t* advance) {
+  return getGlyphAdvanceCacheLocked()
+      ->get(minikinFont->GetUniqueId(), xScale)
+      ->getAdvance(hbFont, glyph, advance);
+}
+
+hb_position_t getPairKerningLocked(const MinikinFont* minikinFont,
+                                   hb_font_t* hbFont,
+                                   float xScale,
+                                   uint16_t first,
+                                   uint16_t second,
+                                   hb_codepoint_t firstGlyph,
+                                   hb_codepoint_t secondGlyph) {
+  GlyphAdvanceCache* cache = getGlyphAdvanceCacheLocked();
+  return cache->get(minikinFont->GetUniqueId(), xScale)
+      ->getKerning(hbFont, cache->buffer(), first, second, firstGlyph,
+                   secondGlyph);
+}
+
+void purgeGlyphAdvancesLocked(const MinikinFont* minikinFont) {
+  assertMinikinLocked();
+  getGlyphAdvanceCacheLocked()->removeFont(minikinFont->GetUniqueId());
+}
+
+void purgeGlyphAdvanceCacheLocked() {
+  getGlyphAdvanceCacheLocked()->clear();
+}
+
+}  // namespace minikin
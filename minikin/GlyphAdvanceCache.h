@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MINIKIN_GLYPH_ADVANCE_CACHE_H
+#define MINIKIN_GLYPH_ADVANCE_CACHE_H
+
+#include <stdint.h>
+
+#include <hb.h>
+
+namespace minikin {
+class MinikinFont;
+
+// How HarfBuzz shapes simple text in a font: left to right Latin-1, kana, CJK
+// ideographs and fullwidth forms, none of which needs normalization or complex
+// script processing.
+enum SimpleShaping {
+  // Lookups apply that can change glyphs or positions in context.
+  kSimpleShapingUnsupported,
+  // Every character maps to its nominal glyph with its default advance.
+  kSimpleShapingPlain,
+  // As kSimpleShapingPlain, except that pair kerning adjusts the advance of
+  // the first glyph of each pair.
+  kSimpleShapingPairKerning,
+};
+
+// Returns how simple text is shaped in the font. The result is computed from
+// the font tables once per font.
+SimpleShaping getSimpleShapingLocked(const MinikinFont* minikinFont);
+
+// Looks up the advance of glyph in hbFont, the HarfBuzz font of minikinFont
+// scaled to xScale. Advances are cached per font and scale. Returns false if
+// the glyph is a mark, ligature or component, which HarfBuzz positions
+// specially.
+bool getGlyphAdvanceLocked(const MinikinFont* minikinFont,
+                           hb_font_t* hbFont,
+                           float xScale,
+                           hb_codepoint_t glyph,
+                           hb_position_t* advance);
+
+// Returns the kerning HarfBuzz adds to the advance of the first glyph of the
+// pair, for a font with kSimpleShapingPairKerning. Kerning is cached per font
+// and scale.
+hb_position_t getPairKerningLocked(const MinikinFont* minikinFont,
+                                   hb_font_t* hbFont,
+                                   float xScale,
+                                   uint16_t first,
+                                   uint16_t second,
+                                   hb_codepoint_t firstGlyph,
+                                   hb_codepoint_t secondGlyph);
+
+// Drops what is cached for a font that is being destroyed.
+void purgeGlyphAdvancesLocked(const MinikinFont* minikinFont);
+void purgeGlyphAdvanceCacheLocked();
+
+}  // namespace minikin
+#endif  // MINIKIN_GLYPH_ADVANCE_CACHE_H
@@ -23,6 +23,10 @@
 #include <hb-ot.h>
 #include <hb.h>
 
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "MinikinFont.h"
 #include "MinikinInternal.h"
 
@@ -30,27 +34,140 @@ namespace minikin {
 
 class HbFontCache : private OnEntryRemoved<int32_t, hb_font_t*> {
  public:
-  HbFontCache() : mCache(kMaxEntries) {
+  HbFontCache()
+      : mCache(LruCache<int32_t, hb_font_t*>::kUnlimitedCapacity),
+        mUsage(0),
+        mHits(0),
+        mMisses(0),
+        mEvictions(0) {
     mCache.setOnEntryRemovedListener(this);
   }
 
   // callback for OnEntryRemoved
   void operator()(int32_t& /* key */, hb_font_t*& value) {
+    hb_face_t* face = hb_font_get_face(value);
     hb_font_destroy(value);
+    mUsage -= kFontOverhead;
+    releaseFace(face);
   }
 
-  hb_font_t* get(int32_t fontId) { return mCache.get(fontId); }
+  hb_font_t* get(int32_t fontId) {
+    hb_font_t* font = mCache.get(fontId);
+    if (font != nullptr) {
+      mHits++;
+    } else {
+      mMisses++;
+    }
+    return font;
+  }
 
-  void put(int32_t fontId, hb_font_t* font) { mCache.put(fontId, font); }
+  // Returns the font with upem scale and the default instance of face, shared
+  // by all the fonts created from the same face. Takes ownership of face. The
+  // returned font is owned by the cache, until every font created from it has
+  // been put and removed again.
+  hb_font_t* acquireParentFont(hb_face_t* face) {
+    if (face == nullptr) {
+      face = hb_face_get_empty();
+    }
+    auto it = mFaces.find(face);
+    if (it != mFaces.end()) {
+      hb_face_destroy(face);
+    } else {
+      FaceEntry entry;
+      entry.parentFont = hb_font_create(face);
+      hb_ot_font_set_funcs(entry.parentFont);
+      unsigned int upem = hb_face_get_upem(face);
+      hb_font_set_scale(entry.parentFont, upem, upem);
+      hb_face_destroy(face);
+      entry.cost = estimateFaceCost(hb_font_get_face(entry.parentFont));
+      entry.fontCount = 0;
+      mUsage += entry.cost;
+      it = mFaces.insert(std::make_pair(face, entry)).first;
+    }
+    it->second.fontCount++;
+    return it->second.parentFont;
+  }
+
+  // Takes ownership of font, which must have been created from a parent font
+  // returned by acquireParentFont.
+  void put(int32_t fontId, hb_font_t* font) {
+    mUsage += kFontOverhead;
+    mCache.put(fontId, font);
+    // Never drop the font that was just added, even if its face alone is over
+    // budget.
+    while (mUsage > kMaxBytes && mCache.size() > 1) {
+      mCache.removeOldest();
+      mEvictions++;
+    }
+  }
 
   void clear() { mCache.clear(); }
 
   void remove(int32_t fontId) { mCache.remove(fontId); }
 
+  HbFontCacheStats getStats() const {
+    HbFontCacheStats stats;
+    stats.hits = mHits;
+    stats.misses = mMisses;
+    stats.evictions = mEvictions;
+    stats.fontCount = mCache.size();
+    stats.faceCount = mFaces.size();
+    stats.usage = mUsage;
+    stats.budget = kMaxBytes;
+    return stats;
+  }
+
  private:
-  static const size_t kMaxEntries = 100;
+  struct FaceEntry {
+    hb_font_t* parentFont;
+    size_t cost;
+    // Number of cached fonts created from parentFont.
+    size_t fontCount;
+  };
+
+  // The memory budget covers the lookup accelerators and cmap caches that
+  // HarfBuzz builds lazily for each face. They are not reported by HarfBuzz,
+  // so they are estimated from the size of the tables they are built from.
+  static const size_t kMaxBytes = 32 * 1024 * 1024;
+  static const size_t kFaceOverhead = 16 * 1024;
+  static const size_t kFontOverhead = 1024;
+
+  static size_t estimateFaceCost(hb_face_t* face) {
+    static const hb_tag_t kTables[] = {
+        HB_TAG('G', 'S', 'U', 'B'), HB_TAG('G', 'P', 'O', 'S'),
+        HB_TAG('G', 'D', 'E', 'F'), HB_TAG('c', 'm', 'a', 'p'),
+        HB_TAG('h', 'm', 't', 'x'), HB_TAG('k', 'e', 'r', 'n'),
+    };
+    size_t cost = kFaceOverhead;
+    for (hb_tag_t tag : kTables) {
+      hb_blob_t* table = hb_face_reference_table(face, tag);
+      cost += hb_blob_get_length(table);
+      hb_blob_destroy(table);
+    }
+    return cost;
+  }
+
+  void releaseFace(hb_face_t* face) {
+    auto it = mFaces.find(face);
+    if (it == mFaces.end() || --it->second.fontCount > 0) {
+      return;
+    }
+    mUsage -= it->second.cost;
+    hb_font_destroy(it->second.parentFont);
+    mFaces.erase(it);
+  }
 
   LruCache<int32_t, hb_font_t*> mCache;
+  // Keyed by the face itself: fonts share a parent font when their
+  // CreateHarfBuzzFace returns the same face, as LayoutFont does for every
+  // font of one file and index. Each face stays alive, and its key unique,
+  // while its parent font is held here.
+  std::unordered_map<hb_face_t*, FaceEntry> mFaces;
+  size_t mUsage;
+
+  size_t mHits;
+  size_t mMisses;
+  size_t mEvictions;
 };
 
 HbFontCache* getFontCacheLocked() {
@@ -93,24 +210,21 @@ hb_font_t* getHbFontLocked(const MinikinFont* minikinFont) {
     return hb_font_reference(font);
   }
 
-  hb_face_t* face = minikinFont->CreateHarfBuzzFace();
-
-  hb_font_t* parent_font = hb_font_create(face);
-  hb_ot_font_set_funcs(parent_font);
-
-  unsigned int upem = hb_face_get_upem(face);
-  hb_font_set_scale(parent_font, upem, upem);
-
+  hb_font_t* parent_font =
+      fontCache->acquireParentFont(minikinFont->CreateHarfBuzzFace());
   font = hb_font_create_sub_font(parent_font);
   std::vector<hb_variation_t> variations;
   for (const FontVariation& variation : minikinFont->GetAxes()) {
       variations.push_back({variation.axisTag, variation.value});
   }
   hb_font_set_variations(font, variations.data(), variations.size());
-  hb_font_destroy(parent_font);
-  hb_face_destroy(face);
   fontCache->put(fontId, font);
   return hb_font_reference(font);
 }
 
+HbFontCacheStats getHbFontCacheStatsLocked() {
+  assertMinikinLocked();
+  return getFontCacheLocked()->getStats();
+}
+
 }  // namespace minikin
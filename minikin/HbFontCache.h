@@ -17,14 +17,30 @@
 #ifndef MINIKIN_HBFONT_CACHE_H
 #define MINIKIN_HBFONT_CACHE_H
 
+#include <stddef.h>
+
 struct hb_font_t;
 
 namespace minikin {
 class MinikinFont;
 
+struct HbFontCacheStats {
+  size_t hits;
+  size_t misses;
+  // Fonts dropped to stay within the memory budget.
+  size_t evictions;
+  size_t fontCount;
+  // Distinct faces, shared by all the cached fonts of the same file.
+  size_t faceCount;
+  // Estimated memory held by the cached faces and fonts, in bytes.
+  size_t usage;
+  size_t budget;
+};
+
 void purgeHbFontCacheLocked();
 void purgeHbFontLocked(const MinikinFont* minikinFont);
 hb_font_t* getHbFontLocked(const MinikinFont* minikinFont);
+HbFontCacheStats getHbFontCacheStatsLocked();
 
 }  // namespace minikin
 #endif  // MINIKIN_HBFONT_CACHE_H
@@ -35,6 +35,7 @@
 #include "Layout.h"
 #include "FontLanguage.h"
 #include "FontLanguageListCache.h"
+#include "GlyphAdvanceCache.h"
 #include "HbFontCache.h"
 #include "LayoutUtils.h"
 #include "MinikinInternal.h"
@@ -43,10 +44,100 @@ namespace minikin {
 
 const int kDirection_Mask = 0x1;
 
+// 64-bit hashing in the style of wyhash: input is consumed 16 bytes at a time,
+// each block folded into the state by a 64x64->128 bit multiply.
+static const uint64_t kHashPrime0 = 0xa0761d6478bd642full;
+static const uint64_t kHashPrime1 = 0xe7037ed1a0b428dbull;
+static const uint64_t kHashPrime2 = 0x8ebc6af09c88c6e3ull;
+
+static inline uint64_t hashMix(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t product = static_cast<__uint128_t>(a) * b;
+  return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+  // The same product from four 32x32->64 bit multiplies.
+  const uint64_t aLow = a & 0xffffffffu, aHigh = a >> 32;
+  const uint64_t bLow = b & 0xffffffffu, bHigh = b >> 32;
+  const uint64_t lowLow = aLow * bLow;
+  const uint64_t lowHigh = aLow * bHigh;
+  const uint64_t highLow = aHigh * bLow;
+  const uint64_t highHigh = aHigh * bHigh;
+  const uint64_t middle =
+      (lowLow >> 32) + (lowHigh & 0xffffffffu) + (highLow & 0xffffffffu);
+  const uint64_t low = (lowLow & 0xffffffffu) | (middle << 32);
+  const uint64_t high =
+      highHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+  return low ^ high;
+#endif
+}
+
+static uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  uint64_t state = seed ^ kHashPrime0;
+  size_t remaining = size;
+  uint64_t a, b;
+  while (remaining > 16) {
+    memcpy(&a, p, sizeof(a));
+    memcpy(&b, p + 8, sizeof(b));
+    state = hashMix(a ^ kHashPrime1, b ^ state);
+    p += 16;
+    remaining -= 16;
+  }
+  uint8_t tail[16] = {};
+  memcpy(tail, p, remaining);
+  memcpy(&a, tail, sizeof(a));
+  memcpy(&b, tail + 8, sizeof(b));
+  state = hashMix(a ^ kHashPrime1, b ^ state);
+  return hashMix(state ^ kHashPrime2, size ^ kHashPrime1);
+}
+
+// The fields of the paint, style and call that affect the layout of every
+// word, packed so that they hash and compare as one block. The hyphen edit
+// changes from word to word and is kept separately.
+struct LayoutPaintKey {
+  uint32_t collectionId;
+  FontStyle style;
+  float size;
+  float scaleX;
+  float skewX;
+  float letterSpacing;
+  int32_t paintFlags;
+  uint32_t isRtl;
+  // Note: any fields added to MinikinPaint must also be reflected here.
+  // TODO: language matching (possibly integrate into style)
+};
+
+// The key is hashed and compared as bytes, which requires that it has no
+// padding.
+static_assert(sizeof(LayoutPaintKey) ==
+                  sizeof(FontStyle) + 7 * sizeof(uint32_t),
+              "LayoutPaintKey must not have padding");
+
 struct LayoutContext {
   MinikinPaint paint;
   FontStyle style;
   std::vector<hb_font_t*> hbFonts;  // parallel to mFaces
+  // HarfBuzz features for the paint, parsed by the first run laid out.
+  std::vector<hb_feature_t> features;
+  bool featuresParsed = false;
+  LayoutPaintKey paintKey;
+  // Hash of paintKey, the seed of the hash of each word.
+  uint64_t paintSignature;
+
+  // Computes paintKey and paintSignature once paint and style are set.
+  void setPaintKey(const std::shared_ptr<FontCollection>& collection,
+                   bool isRtl) {
+    paintKey = LayoutPaintKey();
+    paintKey.collectionId = collection->getId();
+    paintKey.style = style;
+    paintKey.size = paint.size;
+    paintKey.scaleX = paint.scaleX;
+    paintKey.skewX = paint.skewX;
+    paintKey.letterSpacing = paint.letterSpacing;
+    paintKey.paintFlags = paint.paintFlags;
+    paintKey.isRtl = isRtl;
+    paintSignature = hashBytes(&paintKey, sizeof(paintKey), 0);
+  }
 
   void clearHbFonts() {
     for (size_t i = 0; i < hbFonts.size(); i++) {
@@ -61,39 +152,44 @@ struct LayoutContext {
 
 class LayoutCacheKey {
  public:
-  LayoutCacheKey(const std::shared_ptr<FontCollection>& collection,
-                 const MinikinPaint& paint,
-                 FontStyle style,
+  LayoutCacheKey(const LayoutContext& ctx,
                  const uint16_t* chars,
                  size_t start,
                  size_t count,
-                 size_t nchars,
-                 bool dir)
+                 size_t nchars)
       : mChars(chars),
         mNchars(nchars),
         mStart(start),
         mCount(count),
-        mId(collection->getId()),
-        mStyle(style),
-        mSize(paint.size),
-        mScaleX(paint.scaleX),
-        mSkewX(paint.skewX),
-        mLetterSpacing(paint.letterSpacing),
-        mPaintFlags(paint.paintFlags),
-        mHyphenEdit(paint.hyphenEdit),
-        mIsRtl(dir),
-        mHash(computeHash()) {}
+        mHyphenEdit(ctx.paint.hyphenEdit.getHyphen()),
+        mInline(false),
+        mPaint(ctx.paintKey) {
+    const uint64_t seed =
+        ctx.paintSignature ^
+        hashMix((static_cast<uint64_t>(mStart) << 32) | mCount,
+                mHyphenEdit ^ kHashPrime2);
+    mHash = hashBytes(chars, nchars * sizeof(uint16_t), seed);
+  }
   bool operator==(const LayoutCacheKey& other) const;
 
-  hash_t hash() const { return mHash; }
+  hash_t hash() const { return static_cast<hash_t>(mHash ^ (mHash >> 32)); }
 
+  // Makes the key own its text, inline if it is short enough.
   void copyText() {
-    uint16_t* charsCopy = new uint16_t[mNchars];
-    memcpy(charsCopy, mChars, mNchars * sizeof(uint16_t));
-    mChars = charsCopy;
+    if (mNchars <= kInlineChars) {
+      memcpy(mInlineChars, mChars, mNchars * sizeof(uint16_t));
+      mInline = true;
+      mChars = nullptr;
+    } else {
+      uint16_t* charsCopy = new uint16_t[mNchars];
+      memcpy(charsCopy, mChars, mNchars * sizeof(uint16_t));
+      mChars = charsCopy;
+    }
   }
   void freeText() {
-    delete[] mChars;
+    if (!mInline) {
+      delete[] mChars;
+    }
     mChars = NULL;
   }
 
@@ -102,29 +198,27 @@ class LayoutCacheKey {
                 const std::shared_ptr<FontCollection>& collection) const {
     layout->mAdvances.resize(mCount, 0);
     ctx->clearHbFonts();
-    layout->doLayoutRun(mChars, mStart, mCount, mNchars, mIsRtl, ctx,
+    layout->doLayoutRun(chars(), mStart, mCount, mNchars, mPaint.isRtl, ctx,
                         collection);
   }
 
  private:
-  const uint16_t* mChars;
-  size_t mNchars;
-  size_t mStart;
-  size_t mCount;
-  uint32_t mId;  // for the font collection
-  FontStyle mStyle;
-  float mSize;
-  float mScaleX;
-  float mSkewX;
-  float mLetterSpacing;
-  int32_t mPaintFlags;
-  HyphenEdit mHyphenEdit;
-  bool mIsRtl;
-  // Note: any fields added to MinikinPaint must also be reflected here.
-  // TODO: language matching (possibly integrate into style)
-  hash_t mHash;
+  // Words up to this length, which are most of them, are stored in the key.
+  static const size_t kInlineChars = 16;
 
-  hash_t computeHash() const;
+  // Keys are copied into the cache, so inline text is found through mInline
+  // rather than a pointer into the key.
+  const uint16_t* chars() const { return mInline ? mInlineChars : mChars; }
+
+  const uint16_t* mChars;
+  uint32_t mNchars;
+  uint32_t mStart;
+  uint32_t mCount;
+  uint32_t mHyphenEdit;
+  bool mInline;
+  LayoutPaintKey mPaint;
+  uint64_t mHash;
+  uint16_t mInlineChars[kInlineChars];
 };
 
 class LayoutCache : private OnEntryRemoved<LayoutCacheKey, Layout*> {
@@ -135,6 +229,9 @@ class LayoutCache : private OnEntryRemoved<LayoutCacheKey, Layout*> {
 
   void clear() { mCache.clear(); }
 
+  // Returns the cached layout for key, or NULL without laying it out.
+  Layout* find(const LayoutCacheKey& key) { return mCache.get(key); }
+
   Layout* get(LayoutCacheKey& key,
               LayoutContext* ctx,
               const std::shared_ptr<FontCollection>& collection) {
@@ -165,6 +262,109 @@ class LayoutCache : private OnEntryRemoved<LayoutCacheKey, Layout*> {
   static const size_t kMaxEntries = 5000;
 };
 
+// Shape plans are keyed by everything HarfBuzz builds them from: the face, the
+// segment properties of the buffer, the features and the variation
+// coordinates of the font.
+class ShapePlanKey {
+ public:
+  ShapePlanKey(hb_face_t* face,
+               const hb_segment_properties_t& props,
+               const std::vector<hb_feature_t>& features,
+               const int* coords,
+               unsigned int numCoords)
+      : mFace(face),
+        mDirection(props.direction),
+        mScript(props.script),
+        mLanguage(props.language),
+        mFeatures(features),
+        mCoords(coords, coords + numCoords),
+        mHash(computeHash()) {}
+
+  bool operator==(const ShapePlanKey& other) const {
+    return mHash == other.mHash && mFace == other.mFace &&
+           mDirection == other.mDirection && mScript == other.mScript &&
+           mLanguage == other.mLanguage && mCoords == other.mCoords &&
+           mFeatures.size() == other.mFeatures.size() &&
+           !memcmp(mFeatures.data(), other.mFeatures.data(),
+                   mFeatures.size() * sizeof(hb_feature_t));
+  }
+
+  hash_t hash() const { return mHash; }
+
+  hb_face_t* face() const { return mFace; }
+
+ private:
+  hb_face_t* mFace;
+  hb_direction_t mDirection;
+  hb_script_t mScript;
+  hb_language_t mLanguage;
+  std::vector<hb_feature_t> mFeatures;
+  std::vector<int> mCoords;
+  hash_t mHash;
+
+  hash_t computeHash() const {
+    uint32_t hash = JenkinsHashMix(0, hash_type(mFace));
+    hash = JenkinsHashMix(hash, hash_type(static_cast<uint32_t>(mDirection)));
+    hash = JenkinsHashMix(hash, hash_type(static_cast<uint32_t>(mScript)));
+    hash = JenkinsHashMix(hash, hash_type(mLanguage));
+    for (const hb_feature_t& feature : mFeatures) {
+      hash = JenkinsHashMix(hash, feature.tag);
+      hash = JenkinsHashMix(hash, feature.value);
+    }
+    for (int coord : mCoords) {
+      hash = JenkinsHashMix(hash, hash_type(coord));
+    }
+    return JenkinsHashWhiten(hash);
+  }
+};
+
+hash_t hash_type(const ShapePlanKey& key) {
+  return key.hash();
+}
+
+class ShapePlanCache : private OnEntryRemoved<ShapePlanKey, hb_shape_plan_t*> {
+ public:
+  ShapePlanCache() : mCache(kMaxEntries) {
+    mCache.setOnEntryRemovedListener(this);
+  }
+
+  void clear() { mCache.clear(); }
+
+  // Returns the plan for shaping buffer, whose segment properties are set, in
+  // hbFont with features. The cache owns the plan.
+  hb_shape_plan_t* get(hb_font_t* hbFont,
+                       hb_buffer_t* buffer,
+                       const std::vector<hb_feature_t>& features) {
+    hb_face_t* face = hb_font_get_face(hbFont);
+    hb_segment_properties_t props;
+    hb_buffer_get_segment_properties(buffer, &props);
+    unsigned int numCoords;
+    const int* coords = hb_font_get_var_coords_normalized(hbFont, &numCoords);
+    ShapePlanKey key(face, props, features, coords, numCoords);
+    hb_shape_plan_t* plan = mCache.get(key);
+    if (plan == nullptr) {
+      plan = hb_shape_plan_create2(face, &props,
+                                   features.empty() ? NULL : &features[0],
+                                   features.size(), coords, numCoords, NULL);
+      // Plans do not reference their face, so the key does.
+      hb_face_reference(face);
+      mCache.put(key, plan);
+    }
+    return plan;
+  }
+
+ private:
+  // callback for OnEntryRemoved
+  void operator()(ShapePlanKey& key, hb_shape_plan_t*& value) {
+    hb_shape_plan_destroy(value);
+    hb_face_destroy(key.face());
+  }
+
+  LruCache<ShapePlanKey, hb_shape_plan_t*> mCache;
+
+  static const size_t kMaxEntries = 256;
+};
+
 class LayoutEngine {
  public:
   LayoutEngine() {
@@ -176,6 +376,10 @@ class LayoutEngine {
   hb_buffer_t* hbBuffer;
   hb_unicode_funcs_t* unicodeFunctions;
   LayoutCache layoutCache;
+  ShapePlanCache shapePlanCache;
+  // Output of runs shaped without HarfBuzz.
+  std::vector<hb_glyph_info_t> simpleInfos;
+  std::vector<hb_glyph_position_t> simplePositions;
 
   static LayoutEngine& getInstance() {
     static LayoutEngine* instance = new LayoutEngine();
@@ -184,29 +388,11 @@ class LayoutEngine {
 };
 
 bool LayoutCacheKey::operator==(const LayoutCacheKey& other) const {
-  return mId == other.mId && mStart == other.mStart && mCount == other.mCount &&
-         mStyle == other.mStyle && mSize == other.mSize &&
-         mScaleX == other.mScaleX && mSkewX == other.mSkewX &&
-         mLetterSpacing == other.mLetterSpacing &&
-         mPaintFlags == other.mPaintFlags && mHyphenEdit == other.mHyphenEdit &&
-         mIsRtl == other.mIsRtl && mNchars == other.mNchars &&
-         !memcmp(mChars, other.mChars, mNchars * sizeof(uint16_t));
-}
-
-hash_t LayoutCacheKey::computeHash() const {
-  uint32_t hash = JenkinsHashMix(0, mId);
-  hash = JenkinsHashMix(hash, mStart);
-  hash = JenkinsHashMix(hash, mCount);
-  hash = JenkinsHashMix(hash, hash_type(mStyle));
-  hash = JenkinsHashMix(hash, hash_type(mSize));
-  hash = JenkinsHashMix(hash, hash_type(mScaleX));
-  hash = JenkinsHashMix(hash, hash_type(mSkewX));
-  hash = JenkinsHashMix(hash, hash_type(mLetterSpacing));
-  hash = JenkinsHashMix(hash, hash_type(mPaintFlags));
-  hash = JenkinsHashMix(hash, hash_type(mHyphenEdit.getHyphen()));
-  hash = JenkinsHashMix(hash, hash_type(mIsRtl));
-  hash = JenkinsHashMixShorts(hash, mChars, mNchars);
-  return JenkinsHashWhiten(hash);
+  return mHash == other.mHash && mStart == other.mStart &&
+         mCount == other.mCount && mNchars == other.mNchars &&
+         mHyphenEdit == other.mHyphenEdit &&
+         !memcmp(&mPaint, &other.mPaint, sizeof(mPaint)) &&
+         !memcmp(chars(), other.chars(), mNchars * sizeof(uint16_t));
 }
 
 hash_t hash_type(const LayoutCacheKey& key) {
@@ -225,7 +411,11 @@ void MinikinRect::join(const MinikinRect& r) {
 }
 
 void Layout::reset() {
-  mGlyphs.clear();
+  mGlyphIds.clear();
+  mGlyphX.clear();
+  mGlyphY.clear();
+  mClusters.clear();
+  mFontRuns.clear();
   mFaces.clear();
   mBounds.setEmpty();
   mAdvances.clear();
@@ -296,9 +486,8 @@ static hb_position_t HBFloatToFixed(float v) {
 }
 
 void Layout::dump() const {
-  for (size_t i = 0; i < mGlyphs.size(); i++) {
-    const LayoutGlyph& glyph = mGlyphs[i];
-    std::cout << glyph.glyph_id << ": " << glyph.x << ", " << glyph.y
+  for (size_t i = 0; i < mGlyphIds.size(); i++) {
+    std::cout << mGlyphIds[i] << ": " << mGlyphX[i] << ", " << mGlyphY[i]
               << std::endl;
   }
 }
@@ -593,6 +782,7 @@ void Layout::doLayout(const uint16_t* buf,
   LayoutContext ctx;
   ctx.style = style;
   ctx.paint = paint;
+  ctx.setPaintKey(collection, isRtl);
 
   reset();
   mAdvances.resize(count, 0);
@@ -617,6 +807,7 @@ float Layout::measureText(const uint16_t* buf,
   LayoutContext ctx;
   ctx.style = style;
   ctx.paint = paint;
+  ctx.setPaintKey(collection, isRtl);
 
   float advance = doLayoutRunCached(buf, start, count, bufSize, isRtl, &ctx, 0,
                                     collection, NULL, advances);
@@ -691,6 +882,149 @@ float Layout::doLayoutRunCached(
   return advance;
 }
 
+// Returns true if c is simple text, see SimpleShaping: Latin-1 without the
+// soft hyphen, kana without the combining sound marks, CJK ideographs and
+// fullwidth forms.
+static bool isSimpleChar(uint16_t c) {
+  return (c >= 0x0020 && c <= 0x007E) ||
+         (c >= 0x00A0 && c <= 0x00FF && c != 0x00AD) ||
+         (c >= 0x3041 && c <= 0x3096) || (c >= 0x309B && c <= 0x30FF) ||
+         (c >= 0x4E00 && c <= 0x9FFF) || (c >= 0xFF01 && c <= 0xFF5E);
+}
+
+// Returns true if the paint lets a left to right script run of simple text be
+// shaped without HarfBuzz. Hyphen edits only apply to the ends of the word.
+static bool canShapeSimply(const MinikinPaint& paint,
+                           bool isRtl,
+                           ssize_t scriptRunStart,
+                           ssize_t scriptRunEnd,
+                           size_t count) {
+  // Mirroring and font features change the glyphs.
+  if (isRtl || !paint.fontFeatureSettings.empty()) {
+    return false;
+  }
+  if (scriptRunStart == 0 &&
+      paint.hyphenEdit.getStart() != HyphenEdit::NO_EDIT) {
+    return false;
+  }
+  return static_cast<size_t>(scriptRunEnd) != count ||
+         paint.hyphenEdit.getEnd() == HyphenEdit::NO_EDIT;
+}
+
+// Produces the glyphs and positions HarfBuzz would for the script run
+// [scriptRunStart, scriptRunEnd) of buf in font, with the nominal glyph of
+// each character, its cached advance and cached pair kerning. Clusters are
+// indices into buf. Returns false if the run or its font needs HarfBuzz.
+static bool shapeSimpleRun(const uint16_t* buf,
+                           ssize_t scriptRunStart,
+                           ssize_t scriptRunEnd,
+                           const MinikinFont* font,
+                           hb_font_t* hbFont,
+                           float xScale,
+                           std::vector<hb_glyph_info_t>* infos,
+                           std::vector<hb_glyph_position_t>* positions) {
+  const SimpleShaping shaping = getSimpleShapingLocked(font);
+  if (shaping == kSimpleShapingUnsupported) {
+    return false;
+  }
+  infos->clear();
+  positions->clear();
+  for (ssize_t i = scriptRunStart; i < scriptRunEnd; i++) {
+    hb_codepoint_t glyph;
+    hb_position_t advance;
+    // HarfBuzz substitutes glyphs for some missing characters, e.g. a space
+    // for a no-break space, and positions marks specially.
+    if (!isSimpleChar(buf[i]) ||
+        !hb_font_get_nominal_glyph(hbFont, buf[i], &glyph) ||
+        !getGlyphAdvanceLocked(font, hbFont, xScale, glyph, &advance)) {
+      return false;
+    }
+    if (shaping == kSimpleShapingPairKerning && i > scriptRunStart) {
+      positions->back().x_advance +=
+          getPairKerningLocked(font, hbFont, xScale, buf[i - 1], buf[i],
+                               infos->back().codepoint, glyph);
+    }
+    hb_glyph_info_t info = {};
+    info.codepoint = glyph;
+    info.cluster = static_cast<uint32_t>(i);
+    infos->push_back(info);
+    hb_glyph_position_t position = {};
+    position.x_advance = advance;
+    positions->push_back(position);
+  }
+  return true;
+}
+
+// Measures a word of simple text without HarfBuzz. Returns false, leaving
+// *advance unset, if the word or one of its fonts needs shaping.
+static bool measureSimpleWord(const uint16_t* buf,
+                              size_t start,
+                              size_t count,
+                              bool isRtl,
+                              LayoutContext* ctx,
+                              const std::shared_ptr<FontCollection>& collection,
+                              float* advances,
+                              float* advance) {
+  const MinikinPaint& paint = ctx->paint;
+  if (!canShapeSimply(paint, isRtl, 0, count, count)) {
+    return false;
+  }
+  for (size_t i = start; i < start + count; i++) {
+    if (!isSimpleChar(buf[i])) {
+      return false;
+    }
+  }
+
+  std::vector<FontCollection::Run> items;
+  collection->itemize(buf + start, count, ctx->style, &items);
+  const float size = paint.size;
+  const float xScale = size * paint.scaleX;
+  // Simple text has one glyph per character, and is never in a script that
+  // rejects letter spacing, so each character gets all of it, as in
+  // doLayoutRun.
+  float letterSpace = paint.letterSpacing * xScale;
+  if ((paint.paintFlags & LinearTextFlag) == 0) {
+    letterSpace = roundf(letterSpace);
+  }
+  std::vector<hb_glyph_info_t> infos;
+  std::vector<hb_glyph_position_t> positions;
+  float total = 0;
+  for (const FontCollection::Run& run : items) {
+    const MinikinFont* font = run.fakedFont.font;
+    if (font == nullptr) {
+      return false;
+    }
+    hb_font_t* hbFont = getHbFontLocked(font);
+    hb_font_set_ppem(hbFont, xScale, size);
+    hb_font_set_scale(hbFont, HBFloatToFixed(xScale), HBFloatToFixed(size));
+    ssize_t scriptRunEnd;
+    for (ssize_t scriptRunStart = run.start; scriptRunStart < run.end;
+         scriptRunStart = scriptRunEnd) {
+      scriptRunEnd = scriptRunStart;
+      getScriptRun(buf + start, run.end, &scriptRunEnd);
+      if (!shapeSimpleRun(buf + start, scriptRunStart, scriptRunEnd, font,
+                          hbFont, xScale, &infos, &positions)) {
+        hb_font_destroy(hbFont);
+        return false;
+      }
+      for (size_t i = 0; i < infos.size(); i++) {
+        float xAdvance = HBFixedToFloat(positions[i].x_advance);
+        if ((paint.paintFlags & LinearTextFlag) == 0) {
+          xAdvance = roundf(xAdvance);
+        }
+        xAdvance += letterSpace;
+        if (advances) {
+          advances[infos[i].cluster] = xAdvance;
+        }
+        total += xAdvance;
+      }
+    }
+    hb_font_destroy(hbFont);
+  }
+  *advance = total;
+  return true;
+}
+
 float Layout::doLayoutWord(const uint16_t* buf,
                            size_t start,
                            size_t count,
@@ -701,33 +1035,50 @@ float Layout::doLayoutWord(const uint16_t* buf,
                            const std::shared_ptr<FontCollection>& collection,
                            Layout* layout,
                            float* advances) {
-  LayoutCache& cache = LayoutEngine::getInstance().layoutCache;
-  LayoutCacheKey key(collection, ctx->paint, ctx->style, buf, start, count,
-                     bufSize, isRtl);
-
   float wordSpacing =
       count == 1 && isWordSpace(buf[start]) ? ctx->paint.wordSpacing : 0;
 
   float advance;
   if (ctx->paint.skipCache()) {
-    Layout layoutForWord;
-    key.doLayout(&layoutForWord, ctx, collection);
-    if (layout) {
-      layout->appendLayout(&layoutForWord, bufStart, wordSpacing);
-    }
-    if (advances) {
-      layoutForWord.getAdvances(advances);
+    if (layout == nullptr && measureSimpleWord(buf, start, count, isRtl, ctx,
+                                               collection, advances,
+                                               &advance)) {
+      // Measured without shaping.
+    } else {
+      LayoutCacheKey key(*ctx, buf, start, count, bufSize);
+      Layout layoutForWord;
+      key.doLayout(&layoutForWord, ctx, collection);
+      if (layout) {
+        layout->appendLayout(&layoutForWord, bufStart, wordSpacing);
+      }
+      if (advances) {
+        layoutForWord.getAdvances(advances);
+      }
+      advance = layoutForWord.getAdvance();
     }
-    advance = layoutForWord.getAdvance();
   } else {
-    Layout* layoutForWord = cache.get(key, ctx, collection);
-    if (layout) {
-      layout->appendLayout(layoutForWord, bufStart, wordSpacing);
-    }
-    if (advances) {
-      layoutForWord->getAdvances(advances);
+    LayoutCache& cache = LayoutEngine::getInstance().layoutCache;
+    LayoutCacheKey key(*ctx, buf, start, count, bufSize);
+    // A cached word costs one lookup, less than even the simple measurement,
+    // so the fast path only stands in for shaping on a miss. Its results are
+    // not cached: measuring them again is cheap.
+    Layout* layoutForWord = layout == nullptr ? cache.find(key) : nullptr;
+    if (layoutForWord == nullptr && layout == nullptr &&
+        measureSimpleWord(buf, start, count, isRtl, ctx, collection, advances,
+                          &advance)) {
+      // Measured without shaping.
+    } else {
+      if (layoutForWord == nullptr) {
+        layoutForWord = cache.get(key, ctx, collection);
+      }
+      if (layout) {
+        layout->appendLayout(layoutForWord, bufStart, wordSpacing);
+      }
+      if (advances) {
+        layoutForWord->getAdvances(advances);
+      }
+      advance = layoutForWord->getAdvance();
     }
-    advance = layoutForWord->getAdvance();
   }
 
   if (wordSpacing != 0) {
@@ -923,19 +1274,25 @@ void Layout::doLayoutRun(const uint16_t* buf,
   std::vector<FontCollection::Run> items;
   collection->itemize(buf + start, count, ctx->style, &items);
 
-  std::vector<hb_feature_t> features;
-  // Disable default-on non-required ligature features if letter-spacing
-  // See http://dev.w3.org/csswg/css-text-3/#letter-spacing-property
-  // "When the effective spacing between two characters is not zero (due to
-  // either justification or a non-zero value of letter-spacing), user agents
-  // should not apply optional ligatures."
-  if (fabs(ctx->paint.letterSpacing) > 0.03) {
-    static const hb_feature_t no_liga = {HB_TAG('l', 'i', 'g', 'a'), 0, 0, ~0u};
-    static const hb_feature_t no_clig = {HB_TAG('c', 'l', 'i', 'g'), 0, 0, ~0u};
-    features.push_back(no_liga);
-    features.push_back(no_clig);
-  }
-  addFeatures(ctx->paint.fontFeatureSettings, &features);
+  if (!ctx->featuresParsed) {
+    // Disable default-on non-required ligature features if letter-spacing
+    // See http://dev.w3.org/csswg/css-text-3/#letter-spacing-property
+    // "When the effective spacing between two characters is not zero (due to
+    // either justification or a non-zero value of letter-spacing), user
+    // agents should not apply optional ligatures."
+    if (fabs(ctx->paint.letterSpacing) > 0.03) {
+      static const hb_feature_t no_liga = {HB_TAG('l', 'i', 'g', 'a'), 0, 0,
+                                           ~0u};
+      static const hb_feature_t no_clig = {HB_TAG('c', 'l', 'i', 'g'), 0, 0,
+                                           ~0u};
+      ctx->features.push_back(no_liga);
+      ctx->features.push_back(no_clig);
+    }
+    addFeatures(ctx->paint.fontFeatureSettings, &ctx->features);
+    ctx->featuresParsed = true;
+  }
+  const std::vector<hb_feature_t>& features = ctx->features;
+  ShapePlanCache& shapePlanCache = LayoutEngine::getInstance().shapePlanCache;
 
   double size = ctx->paint.size;
   double scaleX = ctx->paint.scaleX;
@@ -1001,33 +1358,49 @@ void Layout::doLayoutRun(const uint16_t* buf,
         letterSpaceHalfRight = letterSpace - letterSpaceHalfLeft;
       }
 
-      hb_buffer_clear_contents(buffer);
-      hb_buffer_set_script(buffer, script);
-      hb_buffer_set_direction(buffer,
-                              isRtl ? HB_DIRECTION_RTL : HB_DIRECTION_LTR);
-      const FontLanguages& langList =
-          FontLanguageListCache::getById(ctx->style.getLanguageListId());
-      if (langList.size() != 0) {
-        const FontLanguage* hbLanguage = &langList[0];
-        for (size_t i = 0; i < langList.size(); ++i) {
-          if (langList[i].supportsHbScript(script)) {
-            hbLanguage = &langList[i];
-            break;
+      LayoutEngine& engine = LayoutEngine::getInstance();
+      uint32_t clusterStart;
+      unsigned int numGlyphs;
+      hb_glyph_info_t* info;
+      hb_glyph_position_t* positions;
+      if (canShapeSimply(ctx->paint, isRtl, scriptRunStart, scriptRunEnd,
+                         count) &&
+          shapeSimpleRun(buf + start, scriptRunStart, scriptRunEnd,
+                         ctx->paint.font, hbFont, size * scaleX,
+                         &engine.simpleInfos, &engine.simplePositions)) {
+        clusterStart = scriptRunStart;
+        numGlyphs = engine.simpleInfos.size();
+        info = engine.simpleInfos.data();
+        positions = engine.simplePositions.data();
+      } else {
+        hb_buffer_clear_contents(buffer);
+        hb_buffer_set_script(buffer, script);
+        hb_buffer_set_direction(buffer,
+                                isRtl ? HB_DIRECTION_RTL : HB_DIRECTION_LTR);
+        const FontLanguages& langList =
+            FontLanguageListCache::getById(ctx->style.getLanguageListId());
+        if (langList.size() != 0) {
+          const FontLanguage* hbLanguage = &langList[0];
+          for (size_t i = 0; i < langList.size(); ++i) {
+            if (langList[i].supportsHbScript(script)) {
+              hbLanguage = &langList[i];
+              break;
+            }
           }
+          hb_buffer_set_language(buffer, hbLanguage->getHbLanguage());
         }
-        hb_buffer_set_language(buffer, hbLanguage->getHbLanguage());
-      }
 
-      const uint32_t clusterStart =
-          addToHbBuffer(buffer, buf, start, count, bufSize, scriptRunStart,
-                        scriptRunEnd, ctx->paint.hyphenEdit, hbFont);
+        clusterStart =
+            addToHbBuffer(buffer, buf, start, count, bufSize, scriptRunStart,
+                          scriptRunEnd, ctx->paint.hyphenEdit, hbFont);
 
-      hb_shape(hbFont, buffer, features.empty() ? NULL : &features[0],
-               features.size());
-      unsigned int numGlyphs;
-      hb_glyph_info_t* info = hb_buffer_get_glyph_infos(buffer, &numGlyphs);
-      hb_glyph_position_t* positions =
-          hb_buffer_get_glyph_positions(buffer, NULL);
+        hb_shape_plan_execute(shapePlanCache.get(hbFont, buffer, features),
+                              hbFont, buffer,
+                              features.empty() ? NULL : &features[0],
+                              features.size());
+        info = hb_buffer_get_glyph_infos(buffer, &numGlyphs);
+        positions = hb_buffer_get_glyph_positions(buffer, NULL);
+      }
 
       // At this point in the code, the cluster values in the info buffer
       // correspond to the input characters with some shift. The cluster value
@@ -1061,10 +1434,8 @@ void Layout::doLayoutRun(const uint16_t* buf,
         float xoff = HBFixedToFloat(positions[i].x_offset);
         float yoff = -HBFixedToFloat(positions[i].y_offset);
         xoff += yoff * ctx->paint.skewX;
-        LayoutGlyph glyph = {
-            font_ix, glyph_ix, x + xoff, y + yoff,
-            static_cast<uint32_t>(info[i].cluster - clusterOffset)};
-        mGlyphs.push_back(glyph);
+        appendGlyph(font_ix, glyph_ix, x + xoff, y + yoff,
+                    static_cast<uint32_t>(info[i].cluster - clusterOffset));
         float xAdvance = HBFixedToFloat(positions[i].x_advance);
         if ((ctx->paint.paintFlags & LinearTextFlag) == 0) {
           xAdvance = roundf(xAdvance);
@@ -1120,15 +1491,29 @@ void Layout::appendLayout(Layout* src, size_t start, float extraAdvance) {
   // LibTxt: Changed x0 from int to float to prevent rounding that causes text
   // jitter.
   float x0 = mAdvance;
-  for (size_t i = 0; i < src->mGlyphs.size(); i++) {
-    LayoutGlyph& srcGlyph = src->mGlyphs[i];
-    int font_ix = fontMap[srcGlyph.font_ix];
-    unsigned int glyph_id = srcGlyph.glyph_id;
-    float x = x0 + srcGlyph.x;
-    float y = srcGlyph.y;
-    LayoutGlyph glyph = {font_ix, glyph_id, x, y,
-                         static_cast<uint32_t>(srcGlyph.cluster + start)};
-    mGlyphs.push_back(glyph);
+  const size_t dst = mGlyphIds.size();
+  const size_t n = src->mGlyphIds.size();
+  for (const FontRun& run : src->mFontRuns) {
+    appendFontRun(dst + run.start, fontMap[run.font_ix]);
+  }
+  mGlyphIds.resize(dst + n);
+  mGlyphX.resize(dst + n);
+  mGlyphY.resize(dst + n);
+  mClusters.resize(dst + n);
+  // Plain loops over contiguous arrays, which the compiler vectorizes.
+  std::copy(src->mGlyphIds.begin(), src->mGlyphIds.end(),
+            mGlyphIds.begin() + dst);
+  std::copy(src->mGlyphY.begin(), src->mGlyphY.end(), mGlyphY.begin() + dst);
+  float* dstX = mGlyphX.data() + dst;
+  const float* srcX = src->mGlyphX.data();
+  for (size_t i = 0; i < n; i++) {
+    dstX[i] = srcX[i] + x0;
+  }
+  uint32_t* dstClusters = mClusters.data() + dst;
+  const uint32_t* srcClusters = src->mClusters.data();
+  const uint32_t clusterOffset = static_cast<uint32_t>(start);
+  for (size_t i = 0; i < n; i++) {
+    dstClusters[i] = srcClusters[i] + clusterOffset;
   }
   for (size_t i = 0; i < src->mAdvances.size(); i++) {
     mAdvances[i + start] = src->mAdvances[i];
@@ -1145,39 +1530,107 @@ void Layout::appendLayout(Layout* src, size_t start, float extraAdvance) {
   }
 }
 
+void Layout::extractLayout(const Layout& src,
+                           size_t start,
+                           size_t count,
+                           bool isRtl,
+                           float offset) {
+  reset();
+  mFaces = src.mFaces;
+  mAdvances.assign(src.mAdvances.begin() + start,
+                   src.mAdvances.begin() + start + count);
+
+  // Glyph clusters are monotonic: increasing for LTR and decreasing for RTL,
+  // so the glyphs of the range are contiguous.
+  const size_t end = start + count;
+  auto firstCluster = std::partition_point(
+      src.mClusters.begin(), src.mClusters.end(), [=](uint32_t cluster) {
+        return isRtl ? cluster >= end : cluster < start;
+      });
+  auto lastCluster = std::partition_point(
+      firstCluster, src.mClusters.end(), [=](uint32_t cluster) {
+        return isRtl ? cluster >= start : cluster < end;
+      });
+  const size_t first = firstCluster - src.mClusters.begin();
+  const size_t last = lastCluster - src.mClusters.begin();
+
+  // The left edge of the range is preceded by the advances of the text before
+  // it in visual order.
+  const float x0 = offset;
+  if (first < last) {
+    for (size_t run = src.fontRunForGlyph(first);
+         run < src.mFontRuns.size() && src.mFontRuns[run].start < last; run++) {
+      appendFontRun(std::max<size_t>(src.mFontRuns[run].start, first) - first,
+                    src.mFontRuns[run].font_ix);
+    }
+  }
+  mGlyphIds.assign(src.mGlyphIds.begin() + first,
+                   src.mGlyphIds.begin() + last);
+  mGlyphY.assign(src.mGlyphY.begin() + first, src.mGlyphY.begin() + last);
+  mGlyphX.resize(last - first);
+  mClusters.resize(last - first);
+  for (size_t i = first; i < last; i++) {
+    mGlyphX[i - first] = src.mGlyphX[i] - x0;
+    mClusters[i - first] = src.mClusters[i] - start;
+  }
+  for (float advance : mAdvances)
+    mAdvance += advance;
+  mBounds.set(src.mBounds);
+  mBounds.offset(-x0, 0);
+}
+
+void Layout::appendGlyph(int font_ix,
+                         unsigned int glyph_id,
+                         float x,
+                         float y,
+                         uint32_t cluster) {
+  appendFontRun(mGlyphIds.size(), font_ix);
+  mGlyphIds.push_back(glyph_id);
+  mGlyphX.push_back(x);
+  mGlyphY.push_back(y);
+  mClusters.push_back(cluster);
+}
+
+void Layout::appendFontRun(size_t start, int font_ix) {
+  if (mFontRuns.empty() || mFontRuns.back().font_ix != font_ix) {
+    mFontRuns.push_back({static_cast<uint32_t>(start), font_ix});
+  }
+}
+
+size_t Layout::fontRunForGlyph(size_t i) const {
+  auto it = std::upper_bound(
+      mFontRuns.begin(), mFontRuns.end(), i,
+      [](size_t glyph, const FontRun& run) { return glyph < run.start; });
+  return it - mFontRuns.begin() - 1;
+}
+
 size_t Layout::nGlyphs() const {
-  return mGlyphs.size();
+  return mGlyphIds.size();
 }
 
 const MinikinFont* Layout::getFont(int i) const {
-  const LayoutGlyph& glyph = mGlyphs[i];
-  return mFaces[glyph.font_ix].font;
+  return mFaces[mFontRuns[fontRunForGlyph(i)].font_ix].font;
 }
 
 FontFakery Layout::getFakery(int i) const {
-  const LayoutGlyph& glyph = mGlyphs[i];
-  return mFaces[glyph.font_ix].fakery;
+  return mFaces[mFontRuns[fontRunForGlyph(i)].font_ix].fakery;
 }
 
 unsigned int Layout::getGlyphId(int i) const {
-  const LayoutGlyph& glyph = mGlyphs[i];
-  return glyph.glyph_id;
+  return mGlyphIds[i];
 }
 
 // libtxt extension
 unsigned int Layout::getGlyphCluster(int i) const {
-  const LayoutGlyph& glyph = mGlyphs[i];
-  return glyph.cluster;
+  return mClusters[i];
 }
 
 float Layout::getX(int i) const {
-  const LayoutGlyph& glyph = mGlyphs[i];
-  return glyph.x;
+  return mGlyphX[i];
 }
 
 float Layout::getY(int i) const {
-  const LayoutGlyph& glyph = mGlyphs[i];
-  return glyph.y;
+  return mGlyphY[i];
 }
 
 float Layout::getAdvance() const {
@@ -1196,7 +1649,9 @@ void Layout::purgeCaches() {
   std::lock_guard<std::recursive_mutex> _l(gMinikinLock);
   LayoutCache& layoutCache = LayoutEngine::getInstance().layoutCache;
   layoutCache.clear();
+  LayoutEngine::getInstance().shapePlanCache.clear();
   purgeHbFontCacheLocked();
+  purgeGlyphAdvanceCacheLocked();
 }
 
 }  // namespace minikin
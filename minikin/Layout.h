@@ -26,23 +26,6 @@
 
 namespace minikin {
 
-struct LayoutGlyph {
-  // index into mFaces and mHbFonts vectors. We could imagine
-  // moving this into a run length representation, because it's
-  // more efficient for long strings, and we'll probably need
-  // something like that for paint attributes (color, underline,
-  // fake b/i, etc), as having those per-glyph is bloated.
-  int font_ix;
-
-  unsigned int glyph_id;
-  float x;
-  float y;
-
-  // libtxt extension: record the cluster (character index) that corresponds
-  // to this glyph
-  uint32_t cluster;
-};
-
 // Internal state used during layout operation
 struct LayoutContext;
 
@@ -62,7 +45,16 @@ enum {
 // may not mutate it at the same time.
 class Layout {
  public:
-  Layout() : mGlyphs(), mAdvances(), mFaces(), mAdvance(0), mBounds() {
+  Layout()
+      : mGlyphIds(),
+        mGlyphX(),
+        mGlyphY(),
+        mClusters(),
+        mFontRuns(),
+        mAdvances(),
+        mFaces(),
+        mAdvance(0),
+        mBounds() {
     mBounds.setEmpty();
   }
 
@@ -93,6 +85,22 @@ class Layout {
                            const std::shared_ptr<FontCollection>& collection,
                            float* advances);
 
+  // libtxt extension: replaces the contents of this layout with the glyphs
+  // and advances that src, laid out with the given direction, produced for
+  // the code units [start, start + count) relative to its own start. Both
+  // ends of the range must fall on word boundaries used by the layout cache
+  // (see getPrevWordBreakForCache), in which case the result is the same as
+  // laying out the range by itself. offset is the sum of the advances of src
+  // to the left of the range: those before it for LTR, after it for RTL.
+  // Callers slicing one layout many times keep prefix sums of its advances.
+  // The bounds are not those of the slice: they are the bounds of the whole of
+  // src, moved with the slice, so they only contain its glyphs.
+  void extractLayout(const Layout& src,
+                     size_t start,
+                     size_t count,
+                     bool isRtl,
+                     float offset);
+
   // public accessors
   size_t nGlyphs() const;
   const MinikinFont* getFont(int i) const;
@@ -102,6 +110,21 @@ class Layout {
   float getX(int i) const;
   float getY(int i) const;
 
+  // libtxt extension: the glyphs as runs of consecutive glyphs that use the
+  // same font. Run r covers glyphs [getFontRunStart(r), getFontRunEnd(r)).
+  size_t nFontRuns() const { return mFontRuns.size(); }
+  size_t getFontRunStart(size_t r) const { return mFontRuns[r].start; }
+  size_t getFontRunEnd(size_t r) const {
+    return r + 1 < mFontRuns.size() ? mFontRuns[r + 1].start
+                                    : mGlyphIds.size();
+  }
+  const MinikinFont* getFontRunFont(size_t r) const {
+    return mFaces[mFontRuns[r].font_ix].font;
+  }
+  FontFakery getFontRunFakery(size_t r) const {
+    return mFaces[mFontRuns[r].font_ix].fakery;
+  }
+
   float getAdvance() const;
 
   // Get advances, copying into caller-provided buffer. The size of this
@@ -165,7 +188,40 @@ class Layout {
   // Append another layout (for example, cached value) into this one
   void appendLayout(Layout* src, size_t start, float extraAdvance);
 
-  std::vector<LayoutGlyph> mGlyphs;
+  // Appends a glyph using font font_ix, extending the last font run if it
+  // uses the same font.
+  void appendGlyph(int font_ix,
+                   unsigned int glyph_id,
+                   float x,
+                   float y,
+                   uint32_t cluster);
+
+  // Starts a font run at glyph index start, unless the last run already uses
+  // font_ix.
+  void appendFontRun(size_t start, int font_ix);
+
+  // Index into mFontRuns of the run that contains glyph i.
+  size_t fontRunForGlyph(size_t i) const;
+
+  // A run of consecutive glyphs that use the same font. It ends where the
+  // next run starts, or at the end of the glyphs.
+  struct FontRun {
+    uint32_t start;
+    // index into mFaces
+    int font_ix;
+  };
+
+  // The glyphs are stored as parallel arrays, so that passes that only need
+  // some of the fields (ids, positions, clusters) only touch those, and so
+  // that offsetting them can be vectorized.
+  std::vector<unsigned int> mGlyphIds;
+  std::vector<float> mGlyphX;
+  std::vector<float> mGlyphY;
+  // libtxt extension: the cluster (character index) that corresponds to each
+  // glyph
+  std::vector<uint32_t> mClusters;
+  // Font indices, run length encoded. Sorted by start.
+  std::vector<FontRun> mFontRuns;
   std::vector<float> mAdvances;
 
   std::vector<FakedFont> mFaces;
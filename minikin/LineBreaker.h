@@ -173,6 +173,18 @@ class LineBreaker {
                     size_t end,
                     bool isRtl);
 
+  // Same as addStyleRun(), but skips measurement: the widths for [start, end)
+  // must already be in charWidths(), typically copied back from an earlier
+  // pass over the same text and paint. Only the break candidates are
+  // recomputed, so this is what a caller should use when nothing but the line
+  // widths changed since the text was last measured.
+  void addMeasuredStyleRun(MinikinPaint* paint,
+                           const std::shared_ptr<FontCollection>& typeface,
+                           FontStyle style,
+                           size_t start,
+                           size_t end,
+                           bool isRtl);
+
   void addReplacement(size_t start, size_t end, float width);
 
   size_t computeBreaks();
@@ -209,6 +221,14 @@ class LineBreaker {
     HyphenationType hyphenType;
   };
 
+  float addStyleRunInternal(MinikinPaint* paint,
+                            const std::shared_ptr<FontCollection>& typeface,
+                            FontStyle style,
+                            size_t start,
+                            size_t end,
+                            bool isRtl,
+                            bool measure);
+
   float currentLineWidth() const;
 
   void addWordBreak(size_t offset,
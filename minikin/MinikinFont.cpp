@@ -15,6 +15,7 @@
  */
 
 #include "MinikinFont.h"
+#include "GlyphAdvanceCache.h"
 #include "HbFontCache.h"
 #include "MinikinInternal.h"
 
@@ -23,6 +24,7 @@ namespace minikin {
 MinikinFont::~MinikinFont() {
   std::lock_guard<std::recursive_mutex> _l(gMinikinLock);
   purgeHbFontLocked(this);
+  purgeGlyphAdvancesLocked(this);
 }
 
 }  // namespace minikin
@@ -31,7 +31,7 @@ namespace minikin {
 class MinikinFont;
 
 // Possibly move into own .h file?
-// Note: if you add a field here, either add it to LayoutCacheKey or to
+// Note: if you add a field here, either add it to LayoutPaintKey or to
 // skipCache()
 struct MinikinPaint {
   MinikinPaint()
@@ -101,6 +101,9 @@ class MinikinFont {
                          uint32_t glyph_id,
                          const MinikinPaint& paint) const = 0;
 
+  // Returns a new reference to the HarfBuzz face of the font. Fonts that return
+  // the same face share the tables and lookup accelerators HarfBuzz builds
+  // from it.
   virtual hb_face_t* CreateHarfBuzzFace() const { return nullptr; }
 
   virtual const std::vector<minikin::FontVariation>& GetAxes() const = 0;
@@ -5,9 +5,11 @@ varying vec2 coord;
 
 uniform mat4 transform;
 uniform mat4 projection;
+// Origin of the text being drawn, so that cached meshes can be reused at any position.
+uniform vec2 offset;
 
 void main()
 {
     coord = aCoord;
-    gl_Position = projection * transform * pos;
+    gl_Position = projection * transform * (pos + vec4(offset, 0.0, 0.0));
 }
\ No newline at end of file
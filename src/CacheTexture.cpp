@@ -135,6 +135,7 @@ void CacheTexture::reset() {
 void CacheTexture::init() {
     // reset, then create a new remainder space to start again
     reset();
+    mGeneration++;
     mCacheBlocks = new CacheBlock(TEXTURE_BORDER_SIZE, TEXTURE_BORDER_SIZE,
                                   getWidth() - TEXTURE_BORDER_SIZE, getHeight() - TEXTURE_BORDER_SIZE);
 }
@@ -151,6 +152,7 @@ void CacheTexture::releasePixelBuffer() {
     mTexture.deleteTexture();
     mDirty = false;
     mCurrentQuad = 0;
+    mGeneration++;
 }
 
 void CacheTexture::setLinearFiltering(bool linearFiltering) {
@@ -159,7 +161,7 @@ void CacheTexture::setLinearFiltering(bool linearFiltering) {
 
 void CacheTexture::allocateMesh() {
     if (!mMesh) {
-        mMesh = new TextureVertex[mMaxQuadCount * 4];
+        mMesh = new GlyphVertex[mMaxQuadCount * 4];
     }
 }
 
@@ -140,7 +140,16 @@ public:
         return mNumGlyphs;
     }
 
-    TextureVertex* mesh() const {
+    /**
+     * Incremented every time the packed glyphs are thrown away, either because the
+     * cache is repacked with init() or its pixels are released. Anything that baked
+     * texture coordinates from this cache is stale once the generation changes.
+     */
+    inline uint32_t getGeneration() const {
+        return mGeneration;
+    }
+
+    GlyphVertex* mesh() const {
         return mMesh;
     }
 
@@ -160,11 +169,18 @@ public:
                         float x2, float y2, float u2, float v2,
                         float x3, float y3, float u3, float v3,
                         float x4, float y4, float u4, float v4) {
-        TextureVertex* mesh = mMesh + mCurrentQuad * 4;
-        TextureVertex::set(mesh++, x2, y2, u2, v2);
-        TextureVertex::set(mesh++, x3, y3, u3, v3);
-        TextureVertex::set(mesh++, x1, y1, u1, v1);
-        TextureVertex::set(mesh++, x4, y4, u4, v4);
+        // Positions are absolute here, and a quad this far from the origin would wrap
+        // around: drop it. Text that far away is drawn through a TextMesh, which
+        // rebases its positions.
+        if (!GlyphVertex::fits(x1, y1) || !GlyphVertex::fits(x2, y2) ||
+            !GlyphVertex::fits(x3, y3) || !GlyphVertex::fits(x4, y4)) {
+            return;
+        }
+        GlyphVertex* mesh = mMesh + mCurrentQuad * 4;
+        GlyphVertex::set(mesh++, x2, y2, u2, v2);
+        GlyphVertex::set(mesh++, x3, y3, u3, v3);
+        GlyphVertex::set(mesh++, x1, y1, u1, v1);
+        GlyphVertex::set(mesh++, x4, y4, u4, v4);
         mCurrentQuad++;
     }
 
@@ -188,7 +204,8 @@ private:
     bool mLinearFiltering = false;
     bool mDirty = false;
     uint16_t mNumGlyphs = 0;
-    TextureVertex* mMesh = nullptr;
+    uint32_t mGeneration = 0;
+    GlyphVertex* mMesh = nullptr;
     uint32_t mCurrentQuad = 0;
     uint32_t mMaxQuadCount;
     CacheBlock* mCacheBlocks;
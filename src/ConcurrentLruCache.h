@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UTILS_CONCURRENT_LRU_CACHE_H
+#define ANDROID_UTILS_CONCURRENT_LRU_CACHE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "LruCache.h"
+
+/**
+ * A lock held for a few instructions at a time: waiting threads spin, yielding
+ * between attempts, instead of sleeping in the kernel.
+ */
+class SpinLock {
+public:
+    void lock() {
+        while (mLocked.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock() {
+        mLocked.clear(std::memory_order_release);
+    }
+
+private:
+    std::atomic_flag mLocked = ATOMIC_FLAG_INIT;
+};
+
+/**
+ * An LruCache that can be shared between threads. Keys are spread over shards by
+ * hash, each an LruCache behind its own SpinLock, so threads only contend when they
+ * hit the same shard. Use order is tracked per shard.
+ *
+ * Every entry has a cost, one by default or whatever the size function returns, and
+ * the cache keeps the total cost of all shards within a budget by evicting the least
+ * recently used entries, first from the shard being written and then from the others.
+ * The removal listener is called with the lock of the entry's shard held, so it must
+ * not call back into the cache.
+ */
+template<typename TKey, typename TValue>
+class ConcurrentLruCache {
+public:
+    // Returns the cost of an entry against the budget, e.g. its size in bytes.
+    typedef size_t (*SizeFunction)(const TKey& key, const TValue& value);
+
+    static const size_t kDefaultShardCount = 16;
+
+    explicit ConcurrentLruCache(size_t budget, size_t shardCount = kDefaultShardCount,
+                                SizeFunction sizeOf = nullptr);
+
+    ~ConcurrentLruCache();
+
+    void setOnEntryRemovedListener(OnEntryRemoved<TKey, TValue>* listener);
+
+    // Returns a copy of the value cached for key, or a null value if there is none.
+    template<typename K>
+    TValue get(const K& key);
+
+    // Returns false, leaving the cache unchanged, if key is already cached or the entry
+    // alone costs more than the whole budget.
+    bool put(const TKey& key, const TValue& value);
+
+    template<typename K>
+    bool remove(const K& key);
+
+    void clear();
+
+    size_t size() const {
+        return mSize.load(std::memory_order_relaxed);
+    }
+
+    size_t usage() const {
+        return mUsage.load(std::memory_order_relaxed);
+    }
+
+    size_t budget() const {
+        return mBudget;
+    }
+
+private:
+    ConcurrentLruCache(const ConcurrentLruCache& that);  // disallow copy constructor
+
+    // Keeps the totals of the cache in step with the entries a shard drops, and
+    // forwards them to the listener.
+    class Shard : private OnEntryRemoved<TKey, TValue> {
+    public:
+        Shard() : cache(LruCache<TKey, TValue>::kUnlimitedCapacity), owner(nullptr) {
+            cache.setOnEntryRemovedListener(this);
+        }
+
+        void operator()(TKey& key, TValue& value) override {
+            owner->mUsage.fetch_sub(owner->costOf(key, value), std::memory_order_relaxed);
+            owner->mSize.fetch_sub(1, std::memory_order_relaxed);
+            if (owner->mListener) {
+                (*owner->mListener)(key, value);
+            }
+        }
+
+        SpinLock lock;
+        LruCache<TKey, TValue> cache;
+        ConcurrentLruCache* owner;
+    };
+
+    size_t costOf(const TKey& key, const TValue& value) const {
+        return mSizeOf ? mSizeOf(key, value) : 1;
+    }
+
+    // A different mix from the one LruCache buckets by, so that the keys of a shard
+    // still spread over its table.
+    Shard& shardFor(hash_t hash) {
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        return mShards[hash % mShardCount];
+    }
+
+    bool overBudget() const {
+        return usage() > mBudget;
+    }
+
+    const size_t mBudget;
+    const size_t mShardCount;
+    const SizeFunction mSizeOf;
+    std::unique_ptr<Shard[]> mShards;
+    std::atomic<size_t> mSize;
+    std::atomic<size_t> mUsage;
+    OnEntryRemoved<TKey, TValue>* mListener;
+    TValue mNullValue;
+};
+
+// Implementation is here, because it's fully templated
+template<typename TKey, typename TValue>
+ConcurrentLruCache<TKey, TValue>::ConcurrentLruCache(size_t budget, size_t shardCount,
+                                                     SizeFunction sizeOf)
+        : mBudget(budget), mShardCount(shardCount > 0 ? shardCount : 1), mSizeOf(sizeOf),
+          mShards(new Shard[mShardCount]), mSize(0), mUsage(0), mListener(NULL),
+          mNullValue(TValue()) {
+    for (size_t i = 0; i < mShardCount; i++) {
+        mShards[i].owner = this;
+    }
+}
+
+template<typename TKey, typename TValue>
+ConcurrentLruCache<TKey, TValue>::~ConcurrentLruCache() {
+    clear();
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentLruCache<TKey, TValue>::setOnEntryRemovedListener(
+        OnEntryRemoved<TKey, TValue>* listener) {
+    mListener = listener;
+}
+
+template<typename TKey, typename TValue>
+template<typename K>
+TValue ConcurrentLruCache<TKey, TValue>::get(const K& key) {
+    Shard& shard = shardFor(hash_type(key));
+    std::lock_guard<SpinLock> lock(shard.lock);
+    return shard.cache.get(key);
+}
+
+template<typename TKey, typename TValue>
+bool ConcurrentLruCache<TKey, TValue>::put(const TKey& key, const TValue& value) {
+    // It could not fit even if every other entry were evicted for it.
+    if (costOf(key, value) > mBudget) {
+        return false;
+    }
+    Shard& shard = shardFor(hash_type(key));
+    {
+        std::lock_guard<SpinLock> lock(shard.lock);
+        if (!shard.cache.put(key, value)) {
+            return false;
+        }
+        mUsage.fetch_add(costOf(key, value), std::memory_order_relaxed);
+        mSize.fetch_add(1, std::memory_order_relaxed);
+        // Make room in this shard first, keeping the new entry.
+        while (overBudget() && shard.cache.size() > 1) {
+            shard.cache.removeOldest();
+        }
+    }
+    // Other shards hold the rest of the budget. Only one lock is held at a time, so
+    // concurrent puts cannot deadlock.
+    for (size_t i = 0; i < mShardCount && overBudget(); i++) {
+        Shard& other = mShards[i];
+        if (&other == &shard) {
+            continue;
+        }
+        std::lock_guard<SpinLock> lock(other.lock);
+        while (overBudget() && other.cache.removeOldest()) {
+        }
+    }
+    return true;
+}
+
+template<typename TKey, typename TValue>
+template<typename K>
+bool ConcurrentLruCache<TKey, TValue>::remove(const K& key) {
+    Shard& shard = shardFor(hash_type(key));
+    std::lock_guard<SpinLock> lock(shard.lock);
+    return shard.cache.remove(key);
+}
+
+template<typename TKey, typename TValue>
+void ConcurrentLruCache<TKey, TValue>::clear() {
+    for (size_t i = 0; i < mShardCount; i++) {
+        std::lock_guard<SpinLock> lock(mShards[i].lock);
+        mShards[i].cache.clear();
+    }
+}
+
+#endif // ANDROID_UTILS_CONCURRENT_LRU_CACHE_H
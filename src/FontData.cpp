@@ -0,0 +1,100 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FontData.h"
+
+std::mutex FontData::sLock;
+std::unordered_map<std::string, std::weak_ptr<FontData>> FontData::sOpenFiles;
+
+FontData::FontData(const std::string& path, const uint8_t* data, size_t size)
+        : mPath(path), mData(data), mSize(size) {
+}
+
+FontData::~FontData() {
+    {
+        std::lock_guard<std::mutex> lock(sLock);
+        auto it = sOpenFiles.find(mPath);
+        // The file may have been mapped again already if it was opened while this
+        // mapping was being released.
+        if (it != sOpenFiles.end() && it->second.expired()) {
+            sOpenFiles.erase(it);
+        }
+    }
+    munmap(const_cast<uint8_t*>(mData), mSize);
+}
+
+std::shared_ptr<FontData> FontData::open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(sLock);
+    auto it = sOpenFiles.find(path);
+    if (it != sOpenFiles.end()) {
+        std::shared_ptr<FontData> data = it->second.lock();
+        if (data) {
+            return data;
+        }
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("FontData: cannot open %s\n", path.c_str());
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        printf("FontData: cannot stat %s\n", path.c_str());
+        close(fd);
+        return nullptr;
+    }
+    size_t size = st.st_size;
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    if (addr == MAP_FAILED) {
+        printf("FontData: cannot map %s\n", path.c_str());
+        return nullptr;
+    }
+
+    std::shared_ptr<FontData> data(new FontData(path, static_cast<const uint8_t*>(addr), size));
+    sOpenFiles[path] = data;
+    return data;
+}
+
+hb_blob_t* FontData::createBlob() {
+    auto* owner = new std::shared_ptr<FontData>(shared_from_this());
+    return hb_blob_create(reinterpret_cast<const char*>(mData), mSize,
+                          HB_MEMORY_MODE_READONLY, owner, releaseBlob);
+}
+
+void FontData::releaseBlob(void* userData) {
+    delete static_cast<std::shared_ptr<FontData>*>(userData);
+}
+
+hb_face_t* FontData::acquireFace(unsigned int index) {
+    std::lock_guard<std::mutex> lock(mFaceLock);
+    auto it = mFaces.find(index);
+    if (it == mFaces.end()) {
+        hb_blob_t* blob = createBlob();
+        hb_face_t* face = hb_face_create(blob, index);
+        hb_blob_destroy(blob);
+        hb_face_make_immutable(face);
+        it = mFaces.emplace(index, SharedFace{face, 0}).first;
+    }
+    it->second.users++;
+    return it->second.face;
+}
+
+void FontData::releaseFace(unsigned int index) {
+    hb_face_t* released = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mFaceLock);
+        auto it = mFaces.find(index);
+        if (it == mFaces.end() || --it->second.users > 0) {
+            return;
+        }
+        released = it->second.face;
+        mFaces.erase(it);
+    }
+    // Outside the lock: the face may hold the last reference to this mapping.
+    hb_face_destroy(released);
+}
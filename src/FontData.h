@@ -0,0 +1,86 @@
+#ifndef FONT_DEMO_FONTDATA_H
+#define FONT_DEMO_FONTDATA_H
+
+#include <hb.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * The contents of a font file, mapped read only into memory. Every FT_Face and
+ * hb_face_t created for the same file shares one mapping, so the file is read by the
+ * kernel on demand and never copied per consumer. The hb_face_t of each index is
+ * shared as well.
+ */
+class FontData : public std::enable_shared_from_this<FontData> {
+public:
+    ~FontData();
+
+    FontData(const FontData&) = delete;
+
+    FontData& operator=(const FontData&) = delete;
+
+    /**
+     * Returns the mapping of the file at path, creating it if the file is not mapped
+     * yet. Returns nullptr if the file cannot be mapped.
+     */
+    static std::shared_ptr<FontData> open(const std::string& path);
+
+    const uint8_t* data() const {
+        return mData;
+    }
+
+    size_t size() const {
+        return mSize;
+    }
+
+    const std::string& path() const {
+        return mPath;
+    }
+
+    /**
+     * Returns a new blob over the whole file. The blob keeps the mapping alive, the
+     * caller owns the returned reference.
+     */
+    hb_blob_t* createBlob();
+
+    /**
+     * Returns the face at index in the file. Every user of the index shares one face, so
+     * its tables are parsed once however many fonts are created from it. The face stays
+     * registered until the matching releaseFace(index), callers that keep it longer take
+     * their own reference.
+     */
+    hb_face_t* acquireFace(unsigned int index);
+
+    /**
+     * Drops one use of the face at index. The registry releases its reference with the
+     * last use, references taken by callers keep the face alive after that.
+     */
+    void releaseFace(unsigned int index);
+
+private:
+    FontData(const std::string& path, const uint8_t* data, size_t size);
+
+    static void releaseBlob(void* userData);
+
+    std::string mPath;
+    const uint8_t* mData;
+    size_t mSize;
+
+    struct SharedFace {
+        hb_face_t* face;
+        size_t users;
+    };
+
+    // Faces in use, by index. Each face keeps this mapping alive through its blob until
+    // its last use is released.
+    std::mutex mFaceLock;
+    std::unordered_map<unsigned int, SharedFace> mFaces;
+
+    // Files that are currently mapped. A mapping goes away with the last face using it.
+    static std::mutex sLock;
+    static std::unordered_map<std::string, std::weak_ptr<FontData>> sOpenFiles;
+};
+
+#endif //FONT_DEMO_FONTDATA_H
@@ -4,7 +4,9 @@
 
 #include <ft2build.h>
 #include <freetype/freetype.h>
+#include <algorithm>
 #include <map>
+#include <unordered_map>
 #include <iostream>
 #include <unistd.h>
 
@@ -29,6 +31,8 @@ FontManager::~FontManager() {
         delete t;
     }
     mTypefaces.clear();
+    mTypefaceIndex.clear();
+    mTypefaceIndexBytes = 0;
     FT_Done_FreeType(mFTLibrary);
 }
 
@@ -325,29 +329,36 @@ static bool AnyMatching(FcPattern* font, FcPattern* pattern, const char* object)
     return false;
 }
 
+size_t FontManager::TypefaceKey::Hasher::operator()(const TypefaceKey& key) const {
+    return std::hash<std::string>()(key.path) ^
+           (std::hash<int>()(key.index) * 31 + std::hash<int>()(key.slant));
+}
+
 Typeface* FontManager::createFontFaceFromFcPattern(FcPattern* pattern) const {
-    FcPatternReference(pattern);
-    auto it = std::find_if(
-            mTypefaces.begin(), mTypefaces.end(),
-            [&pattern](const Typeface* t) {
-                return FcTrue == FcPatternEqual(t->mPattern, pattern);
-            });
-    if (it != mTypefaces.end()) {
-        return *it;
-    }
-    FontStyle style = fontstyle_from_fcpattern(pattern);
-    const char* filename = get_string(pattern, FC_FILE, nullptr);
-    std::cout << "create face: " << filename << std::endl;
     const char* path = get_string(pattern, FC_FILE, nullptr);
-    Typeface* tf = new Typeface(style, pattern);
-    FT_Error err = FT_New_Face(mFTLibrary, path, 0, &tf->mFace);
-    if (err) {
-        printf("FT_New_Face error, filePath: %s, code: %d\n", path, err);
-        delete tf;
+    if (!path) {
         return nullptr;
     }
-    tf->init();
+    TypefaceKey key = {path, get_int(pattern, FC_INDEX, 0),
+                       get_int(pattern, FC_SLANT, FC_SLANT_ROMAN)};
+    auto it = mTypefaceIndex.find(key);
+    if (it != mTypefaceIndex.end()) {
+        return it->second;
+    }
+
+    FcPatternReference(pattern);
+    FontStyle style = fontstyle_from_fcpattern(pattern);
+    std::cout << "create face: " << path << std::endl;
+    // The face itself is only opened once it is used for shaping or rasterization.
+    Typeface* tf = new Typeface(style, pattern, mFTLibrary);
     mTypefaces.push_back(tf);
+
+    size_t bucketCount = mTypefaceIndex.bucket_count();
+    mTypefaceIndexBytes += key.path.capacity() + 1;
+    mTypefaceIndex.emplace(std::move(key), tf);
+    // Each entry is a heap node holding the key, the value and the next pointer.
+    mTypefaceIndexBytes += sizeof(std::pair<const TypefaceKey, Typeface*>) + 2 * sizeof(void*);
+    mTypefaceIndexBytes += (mTypefaceIndex.bucket_count() - bucketCount) * sizeof(void*);
     return tf;
 }
 
@@ -446,6 +457,105 @@ static bool FontContainsCharacter(FcPattern* font, uint32_t character) {
     return false;
 }
 
+const std::string* FallbackIndex::find(uint32_t ch) const {
+    auto it = std::upper_bound(mRanges.begin(), mRanges.end(), ch,
+                               [](uint32_t c, const Range& range) { return c < range.start; });
+    if (it == mRanges.begin()) {
+        return nullptr;
+    }
+    --it;
+    return ch < it->end ? &mFamilies[it->family] : nullptr;
+}
+
+size_t FallbackIndex::getMemoryUsage() const {
+    size_t size = sizeof(FallbackIndex) + mRanges.capacity() * sizeof(Range) +
+                  mFamilies.capacity() * sizeof(std::string);
+    for (const std::string& family : mFamilies) {
+        size += family.capacity() + 1;
+    }
+    return size;
+}
+
+void FallbackIndex::addChar(uint32_t ch, uint32_t family) {
+    if (!mRanges.empty() && mRanges.back().family == family && mRanges.back().end == ch) {
+        mRanges.back().end++;
+    } else {
+        mRanges.push_back({ch, ch + 1, family});
+    }
+}
+
+std::shared_ptr<const FallbackIndex> FontManager::buildFallbackIndex(const char* bcp47) const {
+    AutoFcPattern pattern;
+    fcpattern_from_fontstyle(FontStyle(), pattern);
+    if (bcp47 && *bcp47) {
+        AutoFcLangSet langSet;
+        FcLangSetAdd(langSet, (const FcChar8*) bcp47);
+        FcPatternAddLangSet(pattern, FC_LANG, langSet);
+    }
+    FcConfigSubstitute(mFcConfig, pattern, FcMatchPattern);
+    FcDefaultSubstitute(pattern);
+
+    auto index = std::make_shared<FallbackIndex>();
+    FcResult result;
+    AutoFcFontSet fonts(FcFontSort(mFcConfig, pattern, FcFalse, nullptr, &result));
+    if (nullptr == fonts) {
+        return index;
+    }
+
+    std::unordered_map<std::string, uint32_t> familyIds;
+    AutoFcCharSet covered;
+    for (int i = 0; i < fonts->nfont; ++i) {
+        FcPattern* font = fonts->fonts[i];
+        FcCharSet* charSet;
+        if (!FontAccessible(font) ||
+            FcResultMatch != FcPatternGetCharSet(font, FC_CHARSET, 0, &charSet)) {
+            continue;
+        }
+        // Only the code points that no font sorted earlier covers resolve to this one.
+        AutoFcCharSet added(FcCharSetSubtract(charSet, covered));
+        if (nullptr == added || 0 == FcCharSetCount(added)) {
+            continue;
+        }
+        const char* family = get_string(font, FC_FAMILY);
+        auto inserted = familyIds.emplace(family, index->mFamilies.size());
+        if (inserted.second) {
+            index->mFamilies.push_back(family);
+        }
+        uint32_t familyId = inserted.first->second;
+
+        FcChar32 map[FC_CHARSET_MAP_SIZE];
+        FcChar32 next;
+        for (FcChar32 base = FcCharSetFirstPage(added, map, &next);
+             base != FC_CHARSET_DONE;
+             base = FcCharSetNextPage(added, map, &next)) {
+            for (int word = 0; word < FC_CHARSET_MAP_SIZE; ++word) {
+                for (FcChar32 bits = map[word]; bits; bits &= bits - 1) {
+                    index->addChar(base + word * 32 + __builtin_ctz(bits), familyId);
+                }
+            }
+        }
+        covered.reset(FcCharSetUnion(covered, charSet));
+    }
+
+    std::sort(index->mRanges.begin(), index->mRanges.end(),
+              [](const FallbackIndex::Range& a, const FallbackIndex::Range& b) {
+                  return a.start < b.start;
+              });
+    // Merge the ranges of one family that were split by the order fonts were visited in.
+    std::vector<FallbackIndex::Range> merged;
+    for (const FallbackIndex::Range& range : index->mRanges) {
+        if (!merged.empty() && merged.back().family == range.family &&
+            merged.back().end == range.start) {
+            merged.back().end = range.end;
+        } else {
+            merged.push_back(range);
+        }
+    }
+    merged.shrink_to_fit();
+    index->mRanges = std::move(merged);
+    return index;
+}
+
 Typeface*
 FontManager::matchFamilyStyleCharacter(const char* familyName, const FontStyle& style, const char** bcp47,
                                        int bcp47Count,
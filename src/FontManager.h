@@ -5,6 +5,9 @@
 #pragma once
 
 #include <fontconfig/fontconfig.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include "FontStyle.h"
 #include "FontManager.h"
@@ -34,6 +37,38 @@ private:
     AutoFcFontSet fFontSet;
 };
 
+/**
+ * Maps every code point covered by an installed font to the family fontconfig prefers
+ * for it, for one locale. Built once from the charsets of the sorted font set, so that
+ * resolving a fallback font is a binary search instead of a FcFontMatch call.
+ */
+class FallbackIndex {
+public:
+    /**
+     * Returns the family name to use for the code point, or nullptr if no installed
+     * font covers it.
+     */
+    const std::string* find(uint32_t ch) const;
+
+    size_t getMemoryUsage() const;
+
+private:
+    // Code points [start, end) that resolve to mFamilies[family]
+    struct Range {
+        uint32_t start;
+        uint32_t end;
+        uint32_t family;
+    };
+
+    void addChar(uint32_t ch, uint32_t family);
+
+    // Sorted by start, and never overlapping.
+    std::vector<Range> mRanges;
+    std::vector<std::string> mFamilies;
+
+    friend class FontManager;
+};
+
 class FontManager {
 public:
     FontManager();
@@ -49,16 +84,52 @@ public:
 
     FontStyleSet* matchFamily(const char familyName[]) const;
 
+    /**
+     * Walks the charsets of all installed fonts, in the order fontconfig sorts them for
+     * the locale, and records which family covers each code point first. This is
+     * expensive, callers should build it once per locale and keep it.
+     */
+    std::shared_ptr<const FallbackIndex> buildFallbackIndex(const char* bcp47) const;
+
     static FontManager* getInstance();
 
+    /**
+     * Approximate number of bytes used by the typeface index, keys and hash table
+     * included. The typefaces themselves are not counted.
+     */
+    size_t getTypefaceIndexMemoryUsage() const {
+        return mTypefaceIndexBytes;
+    }
+
 private:
 
+    /**
+     * Identifies a loaded face: the font file, the face index in the file, and the
+     * requested slant, which decides whether the face gets a synthetic italic.
+     */
+    struct TypefaceKey {
+        std::string path;
+        int index;
+        int slant;
+
+        bool operator==(const TypefaceKey& other) const {
+            return index == other.index && slant == other.slant && path == other.path;
+        }
+
+        struct Hasher {
+            size_t operator()(const TypefaceKey& key) const;
+        };
+    };
+
     Typeface* createFontFaceFromFcPattern(FcPattern* pattern) const;
 
     FcConfig* mFcConfig;
     FT_Library mFTLibrary;
 
+    // Owns the typefaces, in creation order.
     mutable std::vector<Typeface*> mTypefaces;
+    mutable std::unordered_map<TypefaceKey, Typeface*, TypefaceKey::Hasher> mTypefaceIndex;
+    mutable size_t mTypefaceIndexBytes = 0;
 
     friend class FontStyleSet;
 };
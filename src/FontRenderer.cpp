@@ -86,6 +86,41 @@ static void font_from_string(const std::string& fontString,
     }
 }
 
+const FontRenderer::ParsedFont& FontRenderer::parseFont(const std::string& font) {
+    auto it = mParsedFonts.find(font);
+    if (it != mParsedFonts.end()) {
+        return it->second;
+    }
+    // Font strings come from the caller and may keep changing, e.g. with an animated
+    // size. Parsing is cheap, so start over rather than grow without bound.
+    if (mParsedFonts.size() >= kMaxParsedFonts) {
+        mParsedFonts.clear();
+    }
+    ParsedFont parsed = {std::string(), 12, FontStyle::kNormal_Weight, false, false};
+    font_from_string(font, parsed.fontName, parsed.textSize, parsed.fontWeight, parsed.bold,
+                     parsed.italic);
+    return mParsedFonts.emplace(font, std::move(parsed)).first->second;
+}
+
+std::shared_ptr<minikin::FontCollection> FontRenderer::getFontCollection(Typeface* face,
+                                                                         FontStyle fs) {
+    uint64_t key = (static_cast<uint64_t>(face->id()) << 32) | fs.value();
+    auto it = mFontCollections.find(key);
+    if (it != mFontCollections.end()) {
+        return it->second;
+    }
+
+    minikin::FontStyle font(minikin::FontLanguageListCache::kEmptyListId, 0, fs.weight() / 100,
+                            fs.slant() == FontStyle::kItalic_Slant);
+    std::vector<minikin::Font> minikin_fonts;
+    minikin_fonts.emplace_back(std::make_shared<LayoutFont>(face), font);
+    std::vector<std::shared_ptr<minikin::FontFamily>> minikin_families;
+    minikin_families.push_back(std::make_shared<minikin::FontFamily>(std::move(minikin_fonts)));
+    auto collection = std::make_shared<minikin::FontCollection>(minikin_families);
+    mFontCollections[key] = collection;
+    return collection;
+}
+
 CacheTexture* FontRenderer::createCacheTexture(int width, int height, GLenum format,
                                                bool allocate) {
     CacheTexture* mCurrentCacheTexture = new CacheTexture(width, height, format, kMaxNumberOfQuads);
@@ -159,9 +194,9 @@ void FontRenderer::checkTextureUpdateForCache(std::vector<CacheTexture*>& cacheT
     }
 }
 
-GlyphInfo* FontRenderer::getCachedGlyph(Typeface* face, uint32_t g) {
+GlyphInfo* FontRenderer::getCachedGlyph(Typeface* face, uint size, uint32_t g) {
     GlyphInfo* glyph = new GlyphInfo;
-    face->generateImage(g, *glyph);
+    face->generateImage(size, g, *glyph);
 
     std::string file = "t_";
     file += g;
@@ -323,17 +358,7 @@ void FontRenderer::layout(minikin::Layout& layout, const std::u16string& text, T
     minikin::FontStyle font(minikin::FontLanguageListCache::kEmptyListId, 0, fs.weight() / 100,
                             fs.slant() == FontStyle::kItalic_Slant);
     minikin::MinikinPaint paint;
-    std::vector<std::shared_ptr<minikin::FontFamily>> minikin_families;
-    std::vector<minikin::Font> minikin_fonts;
-    minikin::Font minikin_font(
-            std::make_shared<LayoutFont>(face), font);
-    minikin_fonts.emplace_back(std::move(minikin_font));
-
-    std::shared_ptr<minikin::FontFamily> minikin_family = std::make_shared<minikin::FontFamily>(
-            std::move(minikin_fonts));
-    minikin_families.push_back(minikin_family);
-    auto font_collection =
-            std::make_shared<minikin::FontCollection>(minikin_families);
+    std::shared_ptr<minikin::FontCollection> font_collection = getFontCollection(face, fs);
 
     paint.size = textSize;
     // Divide by font size so letter spacing is pixels, not proportional to font
@@ -478,8 +503,8 @@ void FontRenderer::layout(minikin::Layout& layout, const std::u16string& text, T
                 glyph_index++;
             } while (glyph_index < text_end);
         }
-        printf("line height: %f \n", face->lineHeight());
-        y += face->lineHeight(); // Line height
+        printf("line height: %f \n", face->lineHeight(textSize));
+        y += face->lineHeight(textSize); // Line height
     }
 
 }
@@ -489,20 +514,16 @@ bool FontRenderer::renderPosText(const char* text, const char* font, int x, int
     std::u16string u16string(icu_text.getBuffer(),
                              icu_text.getBuffer() + icu_text.length());
 
-    std::string fontName;
-    float textSize = 12;
-    int fontWeight = FontStyle::kNormal_Weight;
-    bool bold = false;
-    bool italic = false;
-    font_from_string(font, fontName, textSize, fontWeight, bold, italic);
+    const ParsedFont& parsed = parseFont(font);
+    float textSize = parsed.textSize;
 
-    FontStyle fs(fontWeight, bold ? FontStyle::kExpanded_Width : FontStyle::kNormal_Width,
-                 italic ? FontStyle::kItalic_Slant : FontStyle::kUpright_Slant);
-    Typeface* face = FontManager::getInstance()->matchFamilyStyle(fontName.c_str(), fs);
+    FontStyle fs(parsed.fontWeight,
+                 parsed.bold ? FontStyle::kExpanded_Width : FontStyle::kNormal_Width,
+                 parsed.italic ? FontStyle::kItalic_Slant : FontStyle::kUpright_Slant);
+    Typeface* face = FontManager::getInstance()->matchFamilyStyle(parsed.fontName.c_str(), fs);
     if (!face) {
         return false;
     }
-    face->setSize(textSize);
     std::vector<float> positions;
     positions.resize(u16string.size() * 2);
 
@@ -515,7 +536,7 @@ bool FontRenderer::renderPosText(const char* text, const char* font, int x, int
         GlyphKey key = {face->id(), fs.value(), (uint) textSize, g};
         GlyphInfo* glyph = mGlyphCache.get(key);
         if (!glyph) {
-            glyph = getCachedGlyph(face, g);
+            glyph = getCachedGlyph(face, (uint) textSize, g);
             mGlyphCache.put(key, glyph);
         }
         int penX = x + (int) roundf(positions[(i << 1)]);
@@ -6,6 +6,7 @@
 #define FONT_DEMO_FONTRENDER_H
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "LruCache.h"
 #include "Typeface.h"
@@ -46,6 +47,19 @@ private:
         bool hard_break;
     };
 
+    // The result of font_from_string for one font string.
+    struct ParsedFont {
+        std::string fontName;
+        float textSize;
+        int fontWeight;
+        bool bold;
+        bool italic;
+    };
+
+    const ParsedFont& parseFont(const std::string& font);
+
+    std::shared_ptr<minikin::FontCollection> getFontCollection(Typeface* face, FontStyle fs);
+
     void initTextTexture();
 
     CacheTexture* createCacheTexture(int width, int height, GLenum format,
@@ -54,7 +68,7 @@ private:
     void checkTextureUpdateForCache(std::vector<CacheTexture*>& cacheTextures,
                                     bool& resetPixelStore, GLuint& lastTextureId);
 
-    GlyphInfo* getCachedGlyph(Typeface* face, uint32_t g);
+    GlyphInfo* getCachedGlyph(Typeface* face, uint size, uint32_t g);
 
     void finishRender();
 
@@ -66,6 +80,14 @@ private:
 
     LruCache<GlyphKey, GlyphInfo*> mGlyphCache;
 
+    static const size_t kMaxParsedFonts = 128;
+
+    std::unordered_map<std::string, ParsedFont> mParsedFonts;
+
+    // Single font collections wrapping one typeface, keyed by typeface id in the high
+    // half and style value in the low half.
+    std::unordered_map<uint64_t, std::shared_ptr<minikin::FontCollection>> mFontCollections;
+
     minikin::LineBreaker mBreaker;
 
     std::vector<double> mLineWidths;
@@ -2,6 +2,8 @@
 // Created by bq on 2019-08-20.
 //
 
+#include <algorithm>
+
 #include "GLRenderer.h"
 #include "MeshState.h"
 
@@ -10,19 +12,22 @@ GLRenderer::GLRenderer() {
 }
 
 void GLRenderer::render(CacheTexture& texture) {
+    setOffset(0, 0);
+
     mesh.primitiveMode = GL_TRIANGLES;
     mesh.indices = {meshState.getQuadListIBO(), nullptr};
     mesh.vertices = {
             0,
             1,
             &texture.mesh()[0].x, &texture.mesh()[0].u, nullptr,
-            kTextureVertexStride};
+            kGlyphVertexStride};
     mesh.elementCount = texture.meshElementCount();
 
     meshState.bindMeshBuffer(mesh.vertices.bufferObject);
-    meshState.bindPositionVertexPointer(&texture.mesh()[0].x, mesh.vertices.stride);
+    meshState.bindPositionVertexPointer(&texture.mesh()[0].x, mesh.vertices.stride, GL_SHORT);
     meshState.enableTexCoordsVertexArray();
-    meshState.bindTexCoordsVertexPointer(&texture.mesh()[0].u, mesh.vertices.stride);
+    meshState.bindTexCoordsVertexPointer(&texture.mesh()[0].u, mesh.vertices.stride,
+                                         GL_UNSIGNED_SHORT);
 
     // indices
     meshState.bindIndicesBuffer(mesh.indices.bufferObject);
@@ -31,3 +36,35 @@ void GLRenderer::render(CacheTexture& texture) {
             mesh.primitiveMode, mesh.elementCount, GL_UNSIGNED_SHORT, nullptr);
 
 }
+
+void GLRenderer::render(GLuint buffer, uint32_t firstQuad, uint32_t quadCount,
+                        float offsetX, float offsetY) {
+    setOffset(offsetX, offsetY);
+
+    meshState.bindMeshBuffer(buffer);
+    meshState.enableTexCoordsVertexArray();
+    meshState.bindIndicesBuffer(meshState.getQuadListIBO());
+
+    // The shared index buffer only covers kMaxNumberOfQuads quads, so larger meshes
+    // are drawn in batches by moving the attribute pointers along the buffer.
+    for (uint32_t first = 0; first < quadCount; first += kMaxNumberOfQuads) {
+        const char* vertices = reinterpret_cast<const char*>(
+                static_cast<uintptr_t>(firstQuad + first) * 4 * kGlyphVertexStride);
+        meshState.bindPositionVertexPointer(vertices, kGlyphVertexStride, GL_SHORT);
+        meshState.bindTexCoordsVertexPointer(vertices + kGlyphVertexTextureOffset,
+                                             kGlyphVertexStride, GL_UNSIGNED_SHORT);
+
+        uint32_t count = std::min(quadCount - first, kMaxNumberOfQuads);
+        glDrawElements(GL_TRIANGLES, count * 6, GL_UNSIGNED_SHORT, nullptr);
+    }
+}
+
+void GLRenderer::setOffset(float x, float y) {
+    GLint program = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    if (program != mOffsetProgram) {
+        mOffsetProgram = program;
+        mOffsetLocation = glGetUniformLocation(program, "offset");
+    }
+    glUniform2f(mOffsetLocation, x, y);
+}
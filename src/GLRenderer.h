@@ -43,6 +43,16 @@ public:
 
     void render(CacheTexture& texture);
 
+    // Draws quadCount quads of GlyphVertex stored in the given vertex buffer, starting
+    // at firstQuad, translated by (offsetX, offsetY) through the "offset" uniform.
+    void render(GLuint buffer, uint32_t firstQuad, uint32_t quadCount,
+                float offsetX, float offsetY);
+
+private:
+    void setOffset(float x, float y);
+
+    GLint mOffsetProgram = 0;
+    GLint mOffsetLocation = -1;
 };
 
 #endif //FONT_DEMO_GLRENDERER_H
@@ -70,7 +70,7 @@ public:
     int fPitch;
     uint32_t fWidth, fHeight;
     int32_t fTop, fLeft;
-    CacheTexture* fCacheTexture;
+    CacheTexture* fCacheTexture = nullptr;
 };
 
 #endif //FONT_DEMO_GLYPH_H
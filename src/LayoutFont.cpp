@@ -2,15 +2,18 @@
 // Created by bq on 2019-08-20.
 //
 
-#include <hb-ft.h>
-#include <hb-font.hh>
+#include <hb.h>
 #include "LayoutFont.h"
 #include "minikin/MinikinFont.h"
 
 LayoutFont::LayoutFont(Typeface* typeface)
-        : MinikinFont(typeface->id()), typeface_(typeface) {}
+        : MinikinFont(typeface->id()), typeface_(typeface),
+          face_index_(typeface->faceIndex()) {}
 
 LayoutFont::~LayoutFont() {
+    if (face_) {
+        font_data_->releaseFace(face_index_);
+    }
     typeface_ = nullptr;
 };
 
@@ -26,9 +29,19 @@ void LayoutFont::GetBounds(minikin::MinikinRect* bounds,
 }
 
 hb_face_t* LayoutFont::CreateHarfBuzzFace() const {
-    // if create hb_font_t with this way, we cannot control the layout fully
-    // if we have some special requirement in the future, maybe we shall change it.
-    return hb_ft_face_create(typeface_->mFace, nullptr);
+    // Read the tables straight from the mapped file instead of going through FreeType.
+    // Every typeface of the same file and index gets the same face, whatever its size,
+    // style or variations.
+    std::lock_guard<std::mutex> lock(face_lock_);
+    if (!face_) {
+        font_data_ = typeface_->fontData();
+        if (!font_data_) {
+            // An empty face, if the file cannot be mapped
+            return hb_face_create(nullptr, face_index_);
+        }
+        face_ = font_data_->acquireFace(face_index_);
+    }
+    return hb_face_reference(face_);
 }
 
 const std::vector<minikin::FontVariation>& LayoutFont::GetAxes() const {
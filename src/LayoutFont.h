@@ -5,7 +5,10 @@
 #ifndef FONT_DEMO_LAYOUTFONT_H
 #define FONT_DEMO_LAYOUTFONT_H
 
+#include <memory>
+#include <mutex>
 #include <minikin/MinikinFont.h>
+#include "FontData.h"
 #include "Typeface.h"
 
 class LayoutFont : public minikin::MinikinFont {
@@ -32,6 +35,13 @@ public:
 private:
     Typeface* typeface_;
     std::vector<minikin::FontVariation> variations_;
+
+    // The shared face of the typeface's file and index, acquired on first use and
+    // released with the font.
+    const unsigned int face_index_;
+    mutable std::mutex face_lock_;
+    mutable std::shared_ptr<FontData> font_data_;
+    mutable hb_face_t* face_ = nullptr;
 };
 
 #endif //FONT_DEMO_LAYOUTFONT_H
@@ -17,8 +17,11 @@
 #ifndef ANDROID_UTILS_LRU_CACHE_H
 #define ANDROID_UTILS_LRU_CACHE_H
 
+#include <stdint.h>
 #include <memory>
-#include <unordered_set>
+#include <new>
+#include <type_traits>
+#include <vector>
 #include "JenkinsHash.h"
 
 
@@ -33,6 +36,15 @@ public:
     virtual void operator()(EntryKey& key, EntryValue& value) = 0;
 }; // class OnEntryRemoved
 
+/**
+ * A least recently used cache. Entries live in a slab of fixed size chunks and are
+ * linked in use order by index, and an open addressing table of (hash, entry index)
+ * pairs finds them. Removed entries are reused, so once the cache is warm puts and
+ * evictions do not allocate.
+ *
+ * Lookups accept any key type K for which hash_type(K) is defined and TKey == K
+ * compares, so callers can probe without building a TKey.
+ */
 template<typename TKey, typename TValue>
 class LruCache {
 public:
@@ -48,11 +60,13 @@ public:
 
     size_t size() const;
 
-    const TValue& get(const TKey& key);
+    template<typename K>
+    const TValue& get(const K& key);
 
     bool put(const TKey& key, const TValue& value);
 
-    bool remove(const TKey& key);
+    template<typename K>
+    bool remove(const K& key);
 
     bool removeOldest();
 
@@ -63,46 +77,70 @@ public:
 private:
     LruCache(const LruCache& that);  // disallow copy constructor
 
+    static const uint32_t kNone = UINT32_MAX;
+    static const uint32_t kChunkSize = 64;
+
     struct Entry {
         TKey key;
         TValue value;
-        Entry* parent;
-        Entry* child;
+        hash_t hash;
+        uint32_t parent;
+        uint32_t child;
 
-        Entry(TKey key_, TValue value_) : key(key_), value(value_), parent(NULL), child(NULL) {
+        Entry(const TKey& key_, const TValue& value_, hash_t hash_)
+                : key(key_), value(value_), hash(hash_), parent(kNone), child(kNone) {
         }
-
-        const TKey& getKey() const { return key; }
     };
 
-    struct HashForEntry : public std::unary_function<Entry*, hash_t> {
-        size_t operator()(const Entry* entry) const {
-            return hash_type(entry->key);
-        };
-    };
+    typedef typename std::aligned_storage<sizeof(Entry), alignof(Entry)>::type Slot;
 
-    struct EqualityForHashedEntries : public std::unary_function<Entry*, hash_t> {
-        bool operator()(const Entry* lhs, const Entry* rhs) const {
-            return lhs->key == rhs->key;
-        };
+    // The hash is kept next to the entry index so that most mismatches are rejected
+    // without touching the entry.
+    struct Bucket {
+        hash_t hash;
+        uint32_t entry;
     };
 
-    typedef std::unordered_set<Entry*, HashForEntry, EqualityForHashedEntries> LruCacheSet;
-
-    void attachToCache(Entry& entry);
+    Entry& entryAt(uint32_t index) {
+        return *reinterpret_cast<Entry*>(&mChunks[index / kChunkSize][index % kChunkSize]);
+    }
 
-    void detachFromCache(Entry& entry);
+    const Entry& entryAt(uint32_t index) const {
+        return *reinterpret_cast<const Entry*>(&mChunks[index / kChunkSize][index % kChunkSize]);
+    }
 
-    typename LruCacheSet::iterator findByKey(const TKey& key) {
-        Entry entryForSearch(key, mNullValue);
-        typename LruCacheSet::iterator result = mSet->find(&entryForSearch);
-        return result;
+    // Fibonacci hashing spreads hashes that are small integers over the table.
+    uint32_t homeBucket(hash_t hash) const {
+        return (hash * 2654435769u) >> (32 - mBucketBits);
     }
 
-    std::unique_ptr<LruCacheSet> mSet;
+    template<typename K>
+    uint32_t findBucket(const K& key, hash_t hash) const;
+
+    void insertBucket(hash_t hash, uint32_t entry);
+
+    void eraseBucket(uint32_t bucket);
+
+    void resizeBuckets(uint32_t bits);
+
+    uint32_t allocateEntry();
+
+    void removeAt(uint32_t bucket);
+
+    void attachToCache(uint32_t entry);
+
+    void detachFromCache(uint32_t entry);
+
+    std::vector<Bucket> mBuckets;
+    uint32_t mBucketBits;
+    std::vector<std::unique_ptr<Slot[]>> mChunks;
+    // Entries [0, mUsedEntries) have been handed out, the free ones are in mFreeEntries.
+    uint32_t mUsedEntries;
+    std::vector<uint32_t> mFreeEntries;
+    size_t mSize;
     OnEntryRemoved<TKey, TValue>* mListener;
-    Entry* mOldest;
-    Entry* mYoungest;
+    uint32_t mOldest;
+    uint32_t mYoungest;
     uint32_t mMaxCapacity;
     TValue mNullValue;
 
@@ -111,38 +149,34 @@ public:
     // while (it.next()) {
     //   it.value(); it.key();
     // }
+    // Entries are visited from the least to the most recently used.
     class Iterator {
     public:
         Iterator(const LruCache<TKey, TValue>& cache) :
-                mCache(cache), mIterator(mCache.mSet->begin()), mBeginReturned(false) {
+                mCache(cache), mEntry(kNone), mBeginReturned(false) {
         }
 
         bool next() {
-            if (mIterator == mCache.mSet->end()) {
-                return false;
-            }
             if (!mBeginReturned) {
-                // mIterator has been initialized to the beginning and
-                // hasn't been returned. Do not advance:
                 mBeginReturned = true;
-            } else {
-                std::advance(mIterator, 1);
+                mEntry = mCache.mOldest;
+            } else if (mEntry != kNone) {
+                mEntry = mCache.entryAt(mEntry).child;
             }
-            bool ret = (mIterator != mCache.mSet->end());
-            return ret;
+            return mEntry != kNone;
         }
 
         const TValue& value() const {
-            return (*mIterator)->value;
+            return mCache.entryAt(mEntry).value;
         }
 
         const TKey& key() const {
-            return (*mIterator)->key;
+            return mCache.entryAt(mEntry).key;
         }
 
     private:
         const LruCache<TKey, TValue>& mCache;
-        typename LruCacheSet::iterator mIterator;
+        uint32_t mEntry;
         bool mBeginReturned;
     };
 };
@@ -150,9 +184,14 @@ public:
 // Implementation is here, because it's fully templated
 template<typename TKey, typename TValue>
 LruCache<TKey, TValue>::LruCache(uint32_t maxCapacity)
-        : mSet(new LruCacheSet()), mListener(NULL), mOldest(NULL), mYoungest(NULL), mMaxCapacity(maxCapacity),
-          mNullValue(NULL) {
-    mSet->max_load_factor(1.0);
+        : mBucketBits(0), mUsedEntries(0), mSize(0), mListener(NULL), mOldest(kNone),
+          mYoungest(kNone), mMaxCapacity(maxCapacity), mNullValue(TValue()) {
+    // Size the table of a bounded cache for its capacity up front.
+    uint32_t bits = 4;
+    while (mMaxCapacity != kUnlimitedCapacity && (1u << bits) * 3 < mMaxCapacity * 4) {
+        bits++;
+    }
+    resizeBuckets(bits);
 };
 
 template<typename TKey, typename TValue>
@@ -168,19 +207,20 @@ void LruCache<K, V>::setOnEntryRemovedListener(OnEntryRemoved<K, V>* listener) {
 
 template<typename TKey, typename TValue>
 size_t LruCache<TKey, TValue>::size() const {
-    return mSet->size();
+    return mSize;
 }
 
 template<typename TKey, typename TValue>
-const TValue& LruCache<TKey, TValue>::get(const TKey& key) {
-    typename LruCacheSet::const_iterator find_result = findByKey(key);
-    if (find_result == mSet->end()) {
+template<typename K>
+const TValue& LruCache<TKey, TValue>::get(const K& key) {
+    uint32_t bucket = findBucket(key, hash_type(key));
+    if (bucket == kNone) {
         return mNullValue;
     }
-    Entry* entry = *find_result;
-    detachFromCache(*entry);
-    attachToCache(*entry);
-    return entry->value;
+    uint32_t entry = mBuckets[bucket].entry;
+    detachFromCache(entry);
+    attachToCache(entry);
+    return entryAt(entry).value;
 }
 
 template<typename TKey, typename TValue>
@@ -189,90 +229,181 @@ bool LruCache<TKey, TValue>::put(const TKey& key, const TValue& value) {
         removeOldest();
     }
 
-    if (findByKey(key) != mSet->end()) {
+    hash_t hash = hash_type(key);
+    if (findBucket(key, hash) != kNone) {
         return false;
     }
 
-    Entry* newEntry = new Entry(key, value);
-    mSet->insert(newEntry);
-    attachToCache(*newEntry);
+    // Keep the table at most three quarters full.
+    if ((mSize + 1) * 4 > mBuckets.size() * 3) {
+        resizeBuckets(mBucketBits + 1);
+    }
+    uint32_t entry = allocateEntry();
+    new (&mChunks[entry / kChunkSize][entry % kChunkSize]) Entry(key, value, hash);
+    insertBucket(hash, entry);
+    attachToCache(entry);
+    mSize++;
     return true;
 }
 
 template<typename TKey, typename TValue>
-bool LruCache<TKey, TValue>::remove(const TKey& key) {
-    typename LruCacheSet::const_iterator find_result = findByKey(key);
-    if (find_result == mSet->end()) {
+template<typename K>
+bool LruCache<TKey, TValue>::remove(const K& key) {
+    uint32_t bucket = findBucket(key, hash_type(key));
+    if (bucket == kNone) {
         return false;
     }
-    Entry* entry = *find_result;
-    mSet->erase(entry);
-    if (mListener) {
-        (*mListener)(entry->key, entry->value);
-    }
-    detachFromCache(*entry);
-    delete entry;
+    removeAt(bucket);
     return true;
 }
 
 template<typename TKey, typename TValue>
 bool LruCache<TKey, TValue>::removeOldest() {
-    if (mOldest != NULL) {
-        return remove(mOldest->key);
-        // TODO: should probably abort if false
+    if (mOldest != kNone) {
+        const Entry& oldest = entryAt(mOldest);
+        removeAt(findBucket(oldest.key, oldest.hash));
+        return true;
     }
     return false;
 }
 
 template<typename TKey, typename TValue>
 const TValue& LruCache<TKey, TValue>::peekOldestValue() {
-    if (mOldest) {
-        return mOldest->value;
+    if (mOldest != kNone) {
+        return entryAt(mOldest).value;
     }
     return mNullValue;
 }
 
 template<typename TKey, typename TValue>
 void LruCache<TKey, TValue>::clear() {
-    if (mListener) {
-        for (Entry* p = mOldest; p != NULL; p = p->child) {
-            (*mListener)(p->key, p->value);
+    for (uint32_t p = mOldest; p != kNone;) {
+        Entry& entry = entryAt(p);
+        p = entry.child;
+        if (mListener) {
+            (*mListener)(entry.key, entry.value);
+        }
+        entry.~Entry();
+    }
+    mYoungest = kNone;
+    mOldest = kNone;
+    for (Bucket& bucket : mBuckets) {
+        bucket.entry = kNone;
+    }
+    // Keep the chunks for the entries added next.
+    mUsedEntries = 0;
+    mFreeEntries.clear();
+    mSize = 0;
+}
+
+template<typename TKey, typename TValue>
+template<typename K>
+uint32_t LruCache<TKey, TValue>::findBucket(const K& key, hash_t hash) const {
+    const uint32_t mask = mBuckets.size() - 1;
+    for (uint32_t i = homeBucket(hash);; i = (i + 1) & mask) {
+        const Bucket& bucket = mBuckets[i];
+        if (bucket.entry == kNone) {
+            return kNone;
+        }
+        if (bucket.hash == hash && entryAt(bucket.entry).key == key) {
+            return i;
+        }
+    }
+}
+
+template<typename TKey, typename TValue>
+void LruCache<TKey, TValue>::insertBucket(hash_t hash, uint32_t entry) {
+    const uint32_t mask = mBuckets.size() - 1;
+    uint32_t i = homeBucket(hash);
+    while (mBuckets[i].entry != kNone) {
+        i = (i + 1) & mask;
+    }
+    mBuckets[i].hash = hash;
+    mBuckets[i].entry = entry;
+}
+
+template<typename TKey, typename TValue>
+void LruCache<TKey, TValue>::eraseBucket(uint32_t bucket) {
+    // Backward shift deletion: pull later buckets of the probe sequence into the
+    // hole, so that lookups never need tombstones.
+    const uint32_t mask = mBuckets.size() - 1;
+    uint32_t hole = bucket;
+    for (uint32_t i = (hole + 1) & mask; mBuckets[i].entry != kNone; i = (i + 1) & mask) {
+        uint32_t home = homeBucket(mBuckets[i].hash);
+        // The bucket stays if its home lies cyclically in (hole, i].
+        bool stays = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+        if (!stays) {
+            mBuckets[hole] = mBuckets[i];
+            hole = i;
         }
     }
-    mYoungest = NULL;
-    mOldest = NULL;
-    for (auto entry : *mSet.get()) {
-        delete entry;
+    mBuckets[hole].entry = kNone;
+}
+
+template<typename TKey, typename TValue>
+void LruCache<TKey, TValue>::resizeBuckets(uint32_t bits) {
+    mBucketBits = bits;
+    mBuckets.assign(1u << bits, Bucket{0, kNone});
+    for (uint32_t p = mOldest; p != kNone; p = entryAt(p).child) {
+        insertBucket(entryAt(p).hash, p);
+    }
+}
+
+template<typename TKey, typename TValue>
+uint32_t LruCache<TKey, TValue>::allocateEntry() {
+    if (!mFreeEntries.empty()) {
+        uint32_t entry = mFreeEntries.back();
+        mFreeEntries.pop_back();
+        return entry;
+    }
+    if (mUsedEntries == mChunks.size() * kChunkSize) {
+        mChunks.emplace_back(new Slot[kChunkSize]);
+    }
+    return mUsedEntries++;
+}
+
+template<typename TKey, typename TValue>
+void LruCache<TKey, TValue>::removeAt(uint32_t bucket) {
+    uint32_t index = mBuckets[bucket].entry;
+    eraseBucket(bucket);
+    detachFromCache(index);
+    Entry& entry = entryAt(index);
+    if (mListener) {
+        (*mListener)(entry.key, entry.value);
     }
-    mSet->clear();
+    entry.~Entry();
+    mFreeEntries.push_back(index);
+    mSize--;
 }
 
 template<typename TKey, typename TValue>
-void LruCache<TKey, TValue>::attachToCache(Entry& entry) {
-    if (mYoungest == NULL) {
-        mYoungest = mOldest = &entry;
+void LruCache<TKey, TValue>::attachToCache(uint32_t index) {
+    Entry& entry = entryAt(index);
+    if (mYoungest == kNone) {
+        mYoungest = mOldest = index;
     } else {
         entry.parent = mYoungest;
-        mYoungest->child = &entry;
-        mYoungest = &entry;
+        entryAt(mYoungest).child = index;
+        mYoungest = index;
     }
 }
 
 template<typename TKey, typename TValue>
-void LruCache<TKey, TValue>::detachFromCache(Entry& entry) {
-    if (entry.parent != NULL) {
-        entry.parent->child = entry.child;
+void LruCache<TKey, TValue>::detachFromCache(uint32_t index) {
+    Entry& entry = entryAt(index);
+    if (entry.parent != kNone) {
+        entryAt(entry.parent).child = entry.child;
     } else {
         mOldest = entry.child;
     }
-    if (entry.child != NULL) {
-        entry.child->parent = entry.parent;
+    if (entry.child != kNone) {
+        entryAt(entry.child).parent = entry.parent;
     } else {
         mYoungest = entry.parent;
     }
 
-    entry.parent = NULL;
-    entry.child = NULL;
+    entry.parent = kNone;
+    entry.child = kNone;
 }
 
 #endif // ANDROID_UTILS_LRU_CACHE_H
@@ -19,7 +19,8 @@
 
 MeshState::MeshState()
         : mCurrentIndicesBuffer(0), mCurrentPixelBuffer(0), mCurrentPositionPointer(this), mCurrentPositionStride(0),
-          mCurrentTexCoordsPointer(this), mCurrentTexCoordsStride(0), mTexCoordsArrayEnabled(false),
+          mCurrentPositionType(GL_FLOAT), mCurrentTexCoordsPointer(this), mCurrentTexCoordsStride(0),
+          mCurrentTexCoordsType(GL_FLOAT), mTexCoordsArrayEnabled(false),
           mQuadListIndices(0) {
     glGenBuffers(1, &mUnitQuadBuffer);
     glBindBuffer(GL_ARRAY_BUFFER, mUnitQuadBuffer);
@@ -94,25 +95,31 @@ void MeshState::deleteMeshBuffer(GLuint buffer) {
 // Vertices
 ///////////////////////////////////////////////////////////////////////////////
 
-void MeshState::bindPositionVertexPointer(const GLvoid* vertices, GLsizei stride) {
+void MeshState::bindPositionVertexPointer(const GLvoid* vertices, GLsizei stride, GLenum type) {
     // update pos coords if !current vbo, since vertices may point into mutable memory (e.g. stack)
     if (mCurrentBuffer == 0
         || vertices != mCurrentPositionPointer
-        || stride != mCurrentPositionStride) {
-        glVertexAttribPointer(Program::kBindingPosition, 2, GL_FLOAT, GL_FALSE, stride, vertices);
+        || stride != mCurrentPositionStride
+        || type != mCurrentPositionType) {
+        glVertexAttribPointer(Program::kBindingPosition, 2, type, GL_FALSE, stride, vertices);
         mCurrentPositionPointer = vertices;
         mCurrentPositionStride = stride;
+        mCurrentPositionType = type;
     }
 }
 
-void MeshState::bindTexCoordsVertexPointer(const GLvoid* vertices, GLsizei stride) {
+void MeshState::bindTexCoordsVertexPointer(const GLvoid* vertices, GLsizei stride, GLenum type) {
     // update tex coords if !current vbo, since vertices may point into mutable memory (e.g. stack)
     if (mCurrentBuffer == 0
         || vertices != mCurrentTexCoordsPointer
-        || stride != mCurrentTexCoordsStride) {
-        glVertexAttribPointer(Program::kBindingTexCoords, 2, GL_FLOAT, GL_FALSE, stride, vertices);
+        || stride != mCurrentTexCoordsStride
+        || type != mCurrentTexCoordsType) {
+        // Integer tex coords are fixed point fractions of the texture size
+        GLboolean normalized = type == GL_FLOAT ? GL_FALSE : GL_TRUE;
+        glVertexAttribPointer(Program::kBindingTexCoords, 2, type, normalized, stride, vertices);
         mCurrentTexCoordsPointer = vertices;
         mCurrentTexCoordsStride = stride;
+        mCurrentTexCoordsType = type;
     }
 }
 
@@ -38,8 +38,10 @@ const GLsizei kVertexStride = sizeof(Vertex);
 const GLsizei kAlphaVertexStride = sizeof(AlphaVertex);
 const GLsizei kTextureVertexStride = sizeof(TextureVertex);
 const GLsizei kColorTextureVertexStride = sizeof(ColorTextureVertex);
+const GLsizei kGlyphVertexStride = sizeof(GlyphVertex);
 
 const GLsizei kMeshTextureOffset = 2 * sizeof(float);
+const GLsizei kGlyphVertexTextureOffset = 2 * sizeof(int16_t);
 const GLsizei kVertexAlphaOffset = 2 * sizeof(float);
 const GLsizei kVertexAAWidthOffset = 2 * sizeof(float);
 const GLsizei kVertexAALengthOffset = 3 * sizeof(float);
@@ -74,18 +76,20 @@ public:
     // Vertices
     ///////////////////////////////////////////////////////////////////////////////
     /**
-     * Binds an attrib to the specified float vertex pointer.
-     * Assumes a stride of gTextureVertexStride and a size of 2.
+     * Binds an attrib to the specified vertex pointer, of size 2. The type is
+     * GL_FLOAT, or GL_SHORT for integer positions.
      */
     void bindPositionVertexPointer(const GLvoid* vertices,
-                                   GLsizei stride = kTextureVertexStride);
+                                   GLsizei stride = kTextureVertexStride,
+                                   GLenum type = GL_FLOAT);
 
     /**
-     * Binds an attrib to the specified float vertex pointer.
-     * Assumes a stride of gTextureVertexStride and a size of 2.
+     * Binds an attrib to the specified vertex pointer, of size 2. The type is
+     * GL_FLOAT, or GL_UNSIGNED_SHORT for normalized fixed point coordinates.
      */
     void bindTexCoordsVertexPointer(const GLvoid* vertices,
-                                    GLsizei stride = kTextureVertexStride);
+                                    GLsizei stride = kTextureVertexStride,
+                                    GLenum type = GL_FLOAT);
 
     /**
      * Resets the vertex pointers.
@@ -121,8 +125,10 @@ private:
 
     const void* mCurrentPositionPointer;
     GLsizei mCurrentPositionStride;
+    GLenum mCurrentPositionType;
     const void* mCurrentTexCoordsPointer;
     GLsizei mCurrentTexCoordsStride;
+    GLenum mCurrentTexCoordsType;
 
     bool mTexCoordsArrayEnabled;
 
@@ -62,9 +62,9 @@ TextRenderer::~TextRenderer() {
     mGlyphCache.clear();
 }
 
-GlyphInfo* TextRenderer::getCachedGlyph(Typeface* face, uint32_t g) {
+GlyphInfo* TextRenderer::getCachedGlyph(Typeface* face, uint size, uint32_t g) {
     GlyphInfo* glyph = new GlyphInfo;
-    face->generateImage(g, *glyph);
+    face->generateImage(size, g, *glyph);
 
     std::string file = "t_";
     file += g;
@@ -181,19 +181,20 @@ void TextRenderer::finishRender() {
     }
 }
 
-void TextRenderer::drawTextBlob(txt::RunBuffer* buffer, double x, double y, const txt::TextStyle& style) {
+GlyphInfo* TextRenderer::getGlyph(Typeface* face, const txt::TextStyle& style, uint16_t g) {
+    GlyphKey key = {face->id(), (uint) style.font_weight, (uint) style.font_style,
+                    (uint) style.font_size, g};
+    GlyphInfo* glyph = mGlyphCache.get(key);
+    if (!glyph) {
+        glyph = getCachedGlyph(face, (uint) style.font_size, g);
+        mGlyphCache.put(key, glyph);
+    }
+    return glyph;
+}
 
+void TextRenderer::drawTextBlob(txt::RunBuffer* buffer, double x, double y, const txt::TextStyle& style) {
     for (size_t i = 0; i < buffer->glyphs.size(); i++) {
-        auto g = buffer->glyphs.at(i);
-        buffer->typeface->setSize(style.font_size);
-
-        GlyphKey key = {buffer->typeface->id(), (uint) style.font_weight, (uint) style.font_style,
-                        (uint) style.font_size, g};
-        GlyphInfo* glyph = mGlyphCache.get(key);
-        if (!glyph) {
-            glyph = getCachedGlyph(buffer->typeface, g);
-            mGlyphCache.put(key, glyph);
-        }
+        GlyphInfo* glyph = getGlyph(buffer->typeface, style, buffer->glyphs.at(i));
         int penX = x + (int) roundf(buffer->pos[(i << 1)]);
         int penY = y + (int) roundf(buffer->pos[(i << 1) + 1]);
 
@@ -214,4 +215,104 @@ void TextRenderer::drawTextBlob(txt::RunBuffer* buffer, double x, double y, cons
                                       nPenX, nPenY - height, u1, v1);
     }
     finishRender();
-}
\ No newline at end of file
+}
+
+TextMesh::~TextMesh() {
+    if (mBuffer) {
+        mRenderer->meshState.deleteMeshBuffer(mBuffer);
+    }
+}
+
+void TextRenderer::bakeTextMesh(const std::vector<txt::PaintRecord>& records, TextMesh* mesh) {
+    std::vector<GlyphVertex> vertices;
+    mesh->mSegments.clear();
+    for (const txt::PaintRecord& record : records) {
+        txt::RunBuffer* buffer = record.buffer();
+        for (size_t i = 0; i < buffer->glyphs.size(); i++) {
+            GlyphInfo* glyph = getGlyph(buffer->typeface, record.style(), buffer->glyphs[i]);
+            if (glyph->fCacheTexture != mCurrentCacheTexture) {
+                // Did not fit into the cache, there is nothing to sample from.
+                continue;
+            }
+            float penX = record.offset_x() + roundf(buffer->pos[(i << 1)]);
+            float penY = record.offset_y() + roundf(buffer->pos[(i << 1) + 1]);
+
+            float width = (float) glyph->fWidth;
+            float height = (float) glyph->fHeight;
+
+            float x1 = penX + glyph->fLeft;
+            float y1 = penY + glyph->fTop + height;
+            float x2 = x1 + width;
+            float y2 = y1 - height;
+
+            float u1 = glyph->fBitmapMinU;
+            float u2 = glyph->fBitmapMaxU;
+            float v1 = glyph->fBitmapMinV;
+            float v2 = glyph->fBitmapMaxV;
+
+            // Start a new segment at this glyph when it is out of reach of the origin
+            // of the current one.
+            if (mesh->mSegments.empty() ||
+                !GlyphVertex::fits(x1 - mesh->mSegments.back().originX,
+                                   y1 - mesh->mSegments.back().originY) ||
+                !GlyphVertex::fits(x2 - mesh->mSegments.back().originX,
+                                   y2 - mesh->mSegments.back().originY)) {
+                // A whole pixel origin rounds the glyphs as their absolute positions would.
+                uint32_t firstQuad = vertices.size() / 4;
+                mesh->mSegments.push_back({firstQuad, 0, floorf(penX), floorf(penY)});
+            }
+            TextMesh::Segment& segment = mesh->mSegments.back();
+            x1 -= segment.originX;
+            x2 -= segment.originX;
+            y1 -= segment.originY;
+            y2 -= segment.originY;
+            if (!GlyphVertex::fits(x1, y1) || !GlyphVertex::fits(x2, y2)) {
+                // Larger than the range itself
+                continue;
+            }
+            segment.quadCount++;
+
+            // Same vertex order as CacheTexture::addQuad()
+            size_t quad = vertices.size();
+            vertices.resize(quad + 4);
+            GlyphVertex::set(&vertices[quad], x2, y1, u2, v2);
+            GlyphVertex::set(&vertices[quad + 1], x2, y2, u2, v1);
+            GlyphVertex::set(&vertices[quad + 2], x1, y1, u1, v2);
+            GlyphVertex::set(&vertices[quad + 3], x1, y2, u1, v1);
+        }
+    }
+
+    mesh->mRenderer = mGLRenderer;
+    mesh->mQuadCount = vertices.size() / 4;
+    if (mesh->mQuadCount) {
+        mGLRenderer->meshState.genOrUpdateMeshBuffer(&mesh->mBuffer,
+                                                     vertices.size() * sizeof(GlyphVertex),
+                                                     vertices.data(), GL_STATIC_DRAW);
+    }
+    // Baking may have added glyphs, so take the generation only now.
+    mesh->mCacheTexture = mCurrentCacheTexture;
+    mesh->mGeneration = mCurrentCacheTexture->getGeneration();
+    mesh->mValid = true;
+}
+
+void TextRenderer::drawTextMesh(const std::vector<txt::PaintRecord>& records, TextMesh* mesh,
+                                double x, double y) {
+    if (!mesh->isValidFor(mCurrentCacheTexture)) {
+        bakeTextMesh(records, mesh);
+    }
+    if (!mesh->mQuadCount) {
+        return;
+    }
+
+    GLuint lastTextureId = 0;
+    bool resetPixelStore = false;
+    checkTextureUpdateForCache(mACacheTextures, resetPixelStore, lastTextureId);
+    for (const TextMesh::Segment& segment : mesh->mSegments) {
+        mGLRenderer->render(mesh->mBuffer, segment.firstQuad, segment.quadCount,
+                            x + segment.originX, y + segment.originY);
+    }
+    if (resetPixelStore) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+    mUploadTexture = false;
+}
@@ -14,6 +14,51 @@
 #include "GLRenderer.h"
 #include "paint_record.h"
 
+/**
+ * The glyph quads of a list of paint records, baked once into a vertex buffer relative
+ * to the origin of the records. Drawing it again only needs the new origin. The mesh
+ * stays valid until the records change, which the owner reports with invalidate(), or
+ * until the cache texture it samples from is repacked or released.
+ */
+class TextMesh {
+public:
+    TextMesh() = default;
+
+    ~TextMesh();
+
+    TextMesh(const TextMesh&) = delete;
+
+    TextMesh& operator=(const TextMesh&) = delete;
+
+    void invalidate() {
+        mValid = false;
+    }
+
+private:
+    friend class TextRenderer;
+
+    bool isValidFor(const CacheTexture* cacheTexture) const {
+        return mValid && mCacheTexture == cacheTexture &&
+               mGeneration == cacheTexture->getGeneration();
+    }
+
+    // Quads whose positions are relative to origin, which keeps them within the int16_t
+    // range of GlyphVertex however far the text extends.
+    struct Segment {
+        uint32_t firstQuad;
+        uint32_t quadCount;
+        float originX, originY;
+    };
+
+    GLRenderer* mRenderer = nullptr;
+    GLuint mBuffer = 0;
+    uint32_t mQuadCount = 0;
+    std::vector<Segment> mSegments;
+    CacheTexture* mCacheTexture = nullptr;
+    uint32_t mGeneration = 0;
+    bool mValid = false;
+};
+
 class TextRenderer {
 public:
 
@@ -23,8 +68,19 @@ public:
 
     void drawTextBlob(txt::RunBuffer* buffer, double x, double y, const txt::TextStyle& style);
 
+    /**
+     * Draws the records at (x, y). The quads are taken from mesh, which is rebaked from
+     * the records first if it is not valid anymore.
+     */
+    void drawTextMesh(const std::vector<txt::PaintRecord>& records, TextMesh* mesh,
+                      double x, double y);
+
 private:
 
+    GlyphInfo* getGlyph(Typeface* face, const txt::TextStyle& style, uint16_t g);
+
+    void bakeTextMesh(const std::vector<txt::PaintRecord>& records, TextMesh* mesh);
+
     void initTextTexture();
 
     CacheTexture* createCacheTexture(int width, int height, GLenum format,
@@ -33,7 +89,7 @@ private:
     void checkTextureUpdateForCache(std::vector<CacheTexture*>& cacheTextures,
                                     bool& resetPixelStore, GLuint& lastTextureId);
 
-    GlyphInfo* getCachedGlyph(Typeface* face, uint32_t g);
+    GlyphInfo* getCachedGlyph(Typeface* face, uint size, uint32_t g);
 
     void finishRender();
 
@@ -2,7 +2,9 @@
 // Created by bq on 2019-08-16.
 //
 
+#include <algorithm>
 #include <freetype/ftoutln.h>
+#include <freetype/ftsizes.h>
 #include "Typeface.h"
 #include "GlyphInfo.h"
 #include "stb_image_write.h"
@@ -11,53 +13,62 @@
 #define TRUNC(x)    ((x) >> 6)
 #define ROUND(x)    (((x)+32) & -64)
 
-Typeface::Typeface(FontStyle style, FcPattern* pattern) :
-        mFontStyle(style), mPattern(pattern), mID(getGenerationID()) {
+std::mutex Typeface::sLibraryLock;
+
+Typeface::Typeface(FontStyle style, FcPattern* pattern, FT_Library library) :
+        mLibrary(library), mID(getGenerationID()), mPattern(pattern), mFontStyle(style) {
     mPath = get_string(pattern, FC_FILE, nullptr);
+    mFaceIndex = get_int(pattern, FC_INDEX, 0);
     mFamilyName = get_string(pattern, FC_FAMILY, nullptr);
 }
 
 Typeface::~Typeface() {
     FcPatternDestroy(mPattern);
-    FT_Done_Face(mFace);
-}
-
-unsigned int Typeface::getGenerationID() {
-
-    static std::atomic<uint32_t> nextID{2};
-    uint32_t id;
-    do {
-        id = nextID.fetch_add(2);
-    } while (id == 0);
-    return id;
-}
-
-void Typeface::setSize(uint size) {
-    if (mSize != size) {
-        // printf("FT_Set_Char_Size : %d\n", size);
-        FT_Set_Pixel_Sizes(mFace, size, 0);
-        mSize = size;
-        mMetrics = mFace->size->metrics;
+    if (mFace) {
+        // Releases the sizes created with FT_New_Size as well.
+        std::lock_guard<std::mutex> libraryLock(sLibraryLock);
+        FT_Done_Face(mFace);
     }
 }
 
-double Typeface::ascent() {
-    return (double) mMetrics.ascender / 64;
+std::shared_ptr<FontData> Typeface::fontData() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return fontDataLocked();
 }
 
-double Typeface::descent() {
-    return -(double) mMetrics.descender / 64;
+FT_Face Typeface::face() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return ensureFace() ? mFace : nullptr;
 }
 
-double Typeface::leading() {
-    return (double) (mMetrics.height - mMetrics.ascender + mMetrics.descender) / 64;
+const std::shared_ptr<FontData>& Typeface::fontDataLocked() {
+    if (!mFontData) {
+        mFontData = FontData::open(mPath);
+    }
+    return mFontData;
 }
 
-double Typeface::lineHeight() {
-    return (double) (mMetrics.height) / 64;
-}
+bool Typeface::ensureFace() {
+    if (mFace) {
+        return true;
+    }
+    if (mFaceFailed || !fontDataLocked()) {
+        mFaceFailed = true;
+        return false;
+    }
+    FT_Error err;
+    {
+        std::lock_guard<std::mutex> libraryLock(sLibraryLock);
+        err = FT_New_Memory_Face(mLibrary, mFontData->data(), mFontData->size(), mFaceIndex,
+                                 &mFace);
+    }
+    if (err) {
+        printf("FT_New_Memory_Face error, filePath: %s, code: %d\n", mPath.c_str(), err);
+        mFace = nullptr;
+        mFaceFailed = true;
+        return false;
+    }
 
-void Typeface::init() {
     FT_Select_Charmap(mFace, FT_ENCODING_UNICODE);
     mMatrix.xx = 0x10000;
     mMatrix.yy = 0x10000;
@@ -73,9 +84,80 @@ void Typeface::init() {
         }
     }
 
-    mMetrics = mFace->size->metrics;
     mLoadGlyphFlags = FT_LOAD_NO_BITMAP;
     mGlyphFormat = GlyphInfo::Format_A8;
+    return true;
+}
+
+unsigned int Typeface::getGenerationID() {
+
+    static std::atomic<uint32_t> nextID{2};
+    uint32_t id;
+    do {
+        id = nextID.fetch_add(2);
+    } while (id == 0);
+    return id;
+}
+
+const Typeface::SizeEntry* Typeface::findSize(uint size) {
+    for (size_t i = 0; i < mSizes.size(); i++) {
+        if (mSizes[i].pixelSize == size) {
+            if (i != 0) {
+                std::rotate(mSizes.begin(), mSizes.begin() + i, mSizes.begin() + i + 1);
+            }
+            return &mSizes.front();
+        }
+    }
+    if (!ensureFace()) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> libraryLock(sLibraryLock);
+    FT_Size ftSize;
+    FT_Error err = FT_New_Size(mFace, &ftSize);
+    if (err) {
+        printf("FT_New_Size error, filePath: %s, code: %d\n", mPath.c_str(), err);
+        return nullptr;
+    }
+    FT_Activate_Size(ftSize);
+    err = FT_Set_Pixel_Sizes(mFace, size, 0);
+    if (err) {
+        printf("FT_Set_Pixel_Sizes error: %d, size: %u\n", err, size);
+        FT_Done_Size(ftSize);
+        return nullptr;
+    }
+    if (mSizes.size() >= kMaxSizes) {
+        FT_Done_Size(mSizes.back().size);
+        mSizes.pop_back();
+    }
+    mSizes.insert(mSizes.begin(), SizeEntry{size, ftSize, ftSize->metrics});
+    return &mSizes.front();
+}
+
+FT_Size_Metrics Typeface::sizeMetrics(uint size) {
+    std::lock_guard<std::mutex> lock(mLock);
+    const SizeEntry* entry = findSize(size);
+    if (!entry) {
+        return FT_Size_Metrics();
+    }
+    return entry->metrics;
+}
+
+double Typeface::ascent(uint size) {
+    return (double) sizeMetrics(size).ascender / 64;
+}
+
+double Typeface::descent(uint size) {
+    return -(double) sizeMetrics(size).descender / 64;
+}
+
+double Typeface::leading(uint size) {
+    FT_Size_Metrics metrics = sizeMetrics(size);
+    return (double) (metrics.height - metrics.ascender + metrics.descender) / 64;
+}
+
+double Typeface::lineHeight(uint size) {
+    return (double) (sizeMetrics(size).height) / 64;
 }
 
 static void calculateTransform(FT_Matrix& matrix, int& left, int& right, int& top, int& bottom) {
@@ -113,12 +195,18 @@ static void calculateTransform(FT_Matrix& matrix, int& left, int& right, int& to
     bottom = b;
 }
 
-void Typeface::generateImage(const uint32_t glyph, GlyphInfo& glyphInfo) {
+void Typeface::generateImage(uint size, const uint32_t glyph, GlyphInfo& glyphInfo) {
     // uint32_t index = FT_Get_Char_Index(mFace, glyph);
     // if (!index) {
     //     printf("FT_Get_Char_Index error: %d\n", glyph);
     //     return;
     // }
+    std::lock_guard<std::mutex> lock(mLock);
+    const SizeEntry* entry = findSize(size);
+    if (!entry) {
+        return;
+    }
+    FT_Activate_Size(entry->size);
     FT_Error err = FT_Load_Glyph(mFace, glyph, mLoadGlyphFlags);
     if (err) {
         printf("FT_Load_Glyph error: %d\n", err);
@@ -164,8 +252,10 @@ void Typeface::generateImage(const uint32_t glyph, GlyphInfo& glyphInfo) {
     }
 }
 
-void Typeface::getMetrics(FontMetrics* metrics) {
-    metrics->fAscent = -ascent();
-    metrics->fDescent = -descent();
-    metrics->fLeading = leading();
+void Typeface::getMetrics(uint size, FontMetrics* metrics) {
+    FT_Size_Metrics sizeMetrics = this->sizeMetrics(size);
+    metrics->fAscent = -(double) sizeMetrics.ascender / 64;
+    metrics->fDescent = (double) sizeMetrics.descender / 64;
+    metrics->fLeading = (double) (sizeMetrics.height - sizeMetrics.ascender +
+                                  sizeMetrics.descender) / 64;
 }
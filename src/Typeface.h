@@ -5,38 +5,44 @@
 #ifndef FONT_DEMO_TYPEFACE_H
 #define FONT_DEMO_TYPEFACE_H
 
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 #include <ft2build.h>
 #include <freetype/freetype.h>
 #include "Util.h"
 #include "GlyphInfo.h"
 #include "FontStyle.h"
 #include "FontMetrics.h"
+#include "FontData.h"
 
 class FontManager;
 
+/**
+ * A handle to one face of a font file. Creating it only reads the fontconfig pattern:
+ * the file is mapped, and the FreeType face opened, the first time they are needed to
+ * shape or rasterize.
+ */
 class Typeface {
 public:
 
-    Typeface(FontStyle style, FcPattern* pattern);
+    Typeface(FontStyle style, FcPattern* pattern, FT_Library library);
 
     ~Typeface();
 
-    void generateImage(const uint32_t glyph, GlyphInfo& glyphInfo);
+    // Rasterizes glyph at the given pixel size.
+    void generateImage(uint size, const uint32_t glyph, GlyphInfo& glyphInfo);
 
     uint32_t id() const { return mID; };
 
-    void setSize(uint size);
+    double ascent(uint size);
 
-    void init();
+    double descent(uint size);
 
-    double ascent();
+    double leading(uint size);
 
-    double descent();
-
-    double leading();
-
-    double lineHeight();
+    double lineHeight(uint size);
 
     FontStyle fontStyle() const {
         return mFontStyle;
@@ -50,22 +56,68 @@ public:
         return mPath;
     }
 
-    void getMetrics(FontMetrics* metrics);
+    // Index of the face in its font file.
+    int faceIndex() const {
+        return mFaceIndex;
+    }
+
+    // The mapped font file the face reads from, shared with every other face of the file.
+    // Maps the file if needed, returns nullptr if it cannot be mapped.
+    std::shared_ptr<FontData> fontData();
+
+    // The FreeType face, opened if needed. Returns nullptr if it cannot be opened.
+    FT_Face face();
 
-    FT_Face mFace;
+    void getMetrics(uint size, FontMetrics* metrics);
 
 private:
 
+    // One FT_Size of the face, with its metrics.
+    struct SizeEntry {
+        uint pixelSize;
+        FT_Size size;
+        FT_Size_Metrics metrics;
+    };
+
+    // Number of sizes kept per face. Older sizes are released first.
+    static const size_t kMaxSizes = 8;
+
+    // Must be called with mLock held.
+    bool ensureFace();
+
+    // Must be called with mLock held.
+    const std::shared_ptr<FontData>& fontDataLocked();
+
+    // Returns the entry for size, creating it if needed, or nullptr if the face cannot be
+    // opened or sized. Must be called with mLock held.
+    const SizeEntry* findSize(uint size);
+
+    FT_Size_Metrics sizeMetrics(uint size);
+
     unsigned int getGenerationID();
 
+    FT_Library mLibrary;
+    // FreeType requires faces and sizes to be created and released one at a time per
+    // library, and every typeface shares the library of the FontManager. Taken after
+    // mLock, never before it.
+    static std::mutex sLibraryLock;
+    FT_Face mFace = nullptr;
+    // Set once opening the face failed, so that it is not retried for every glyph.
+    bool mFaceFailed = false;
+
     uint32_t mID;
-    int mSize;
+    // Guards the face, its sizes and the mapping: FreeType faces must not be used from
+    // two threads at once.
+    std::mutex mLock;
+    // Most recently used first.
+    std::vector<SizeEntry> mSizes;
     FT_Matrix mMatrix;
     FcPattern* mPattern;
     std::string mPath;
+    int mFaceIndex = 0;
+    std::shared_ptr<FontData> mFontData;
     bool mTransform;
     GlyphInfo::GlyphFormat mGlyphFormat;
-    FT_Size_Metrics mMetrics;
     unsigned int mLoadGlyphFlags;
     FontStyle mFontStyle;
 
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fallback_match_cache.h"
+
+#include <mutex>
+
+namespace txt {
+
+FallbackMatchCache::FallbackMatchCache(size_t capacity)
+        : capacity_(capacity), hits_(0), misses_(0), evictions_(0) {}
+
+const std::shared_ptr<minikin::FontFamily>* FallbackMatchCache::Find(
+        uint32_t ch,
+        const std::string& locale) {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    auto locale_id = locale_ids_.find(locale);
+    if (locale_id != locale_ids_.end()) {
+        auto entry = entries_.find(MakeKey(ch, locale_id->second));
+        if (entry != entries_.end()) {
+            hits_++;
+            return entry->second;
+        }
+    }
+    misses_++;
+    return nullptr;
+}
+
+void FallbackMatchCache::Insert(
+        uint32_t ch,
+        const std::string& locale,
+        const std::shared_ptr<minikin::FontFamily>* family) {
+    std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+    auto locale_id =
+            locale_ids_.emplace(locale, static_cast<uint32_t>(locale_ids_.size()))
+                    .first->second;
+    Key key = MakeKey(ch, locale_id);
+    if (!entries_.emplace(key, family).second) {
+        return;
+    }
+    order_.push_back(key);
+    while (entries_.size() > capacity_) {
+        entries_.erase(order_.front());
+        order_.pop_front();
+        evictions_++;
+    }
+}
+
+void FallbackMatchCache::Clear() {
+    std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+    entries_.clear();
+    order_.clear();
+}
+
+FallbackMatchCache::Stats FallbackMatchCache::GetStats() const {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    return {hits_, misses_, evictions_, entries_.size()};
+}
+
+}  // namespace txt
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIB_TXT_SRC_FALLBACK_MATCH_CACHE_H_
+#define LIB_TXT_SRC_FALLBACK_MATCH_CACHE_H_
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include "../minikin/FontFamily.h"
+
+namespace txt {
+
+// Caches the fallback family matched for a code point, per locale. Lookups
+// only take a shared lock, so any number of threads can read concurrently.
+// The cache holds at most |capacity| entries and drops the oldest ones first.
+//
+// Entries point at families owned by the caller, which must outlive the cache
+// and never move.
+class FallbackMatchCache {
+public:
+    struct Stats {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t size;
+    };
+
+    explicit FallbackMatchCache(size_t capacity);
+
+    // Returns the family cached for ch in locale, or nullptr if there is none.
+    const std::shared_ptr<minikin::FontFamily>* Find(uint32_t ch,
+                                                     const std::string& locale);
+
+    void Insert(uint32_t ch,
+                const std::string& locale,
+                const std::shared_ptr<minikin::FontFamily>* family);
+
+    void Clear();
+
+    Stats GetStats() const;
+
+private:
+    // The locale id goes in the high half, the code point in the low half.
+    typedef uint64_t Key;
+
+    static Key MakeKey(uint32_t ch, uint32_t locale_id) {
+        return (static_cast<uint64_t>(locale_id) << 32) | ch;
+    }
+
+    const size_t capacity_;
+    mutable std::shared_timed_mutex mutex_;
+    // Locale strings are interned so that keys stay small.
+    std::unordered_map<std::string, uint32_t> locale_ids_;
+    std::unordered_map<Key, const std::shared_ptr<minikin::FontFamily>*>
+            entries_;
+    // Keys in insertion order, for eviction.
+    std::deque<Key> order_;
+
+    std::atomic<size_t> hits_;
+    std::atomic<size_t> misses_;
+    std::atomic<size_t> evictions_;
+};
+
+}  // namespace txt
+
+#endif  // LIB_TXT_SRC_FALLBACK_MATCH_CACHE_H_
@@ -22,12 +22,12 @@
 #include <mutex>
 #include <set>
 #include <string>
-#include <sstream>
 #include <unordered_map>
 #include <vector>
 #include "platform.h"
 #include "Typeface.h"
 #include "LayoutFont.h"
+#include "../minikin/FontLanguageListCache.h"
 
 namespace txt {
 
@@ -35,27 +35,21 @@ namespace {
 
 const std::shared_ptr<minikin::FontFamily> g_null_family;
 
-}  // anonymous namespace
-
-FontCollection::FamilyKey::FamilyKey(const std::vector<std::string>& families,
-                                     const std::string& loc) {
-    locale = loc;
+// Enough for the code points of a few scripts and emoji in a handful of locales.
+const size_t kFallbackMatchCacheCapacity = 8192;
 
-    std::stringstream stream;
-    for_each(families.begin(), families.end(),
-             [&stream](const std::string& str) { stream << str << ','; });
-    font_families = stream.str();
-}
+}  // anonymous namespace
 
 bool FontCollection::FamilyKey::operator==(
         const FontCollection::FamilyKey& other) const {
-    return font_families == other.font_families && locale == other.locale;
+    return font_families_id == other.font_families_id &&
+           locale_id == other.locale_id;
 }
 
 size_t FontCollection::FamilyKey::Hasher::operator()(
         const FontCollection::FamilyKey& key) const {
-    return std::hash<std::string>()(key.font_families) ^
-           std::hash<std::string>()(key.locale);
+    return std::hash<uint64_t>()(
+            (static_cast<uint64_t>(key.font_families_id) << 32) | key.locale_id);
 }
 
 class TxtFallbackFontProvider
@@ -79,7 +73,12 @@ private:
     std::weak_ptr<FontCollection> font_collection_;
 };
 
-FontCollection::FontCollection() : enable_font_fallback_(true) { SetupDefaultFontManager(); }
+FontCollection::FontCollection()
+        : fallback_match_cache_(kFallbackMatchCacheCapacity),
+          enable_font_fallback_(true),
+          use_fallback_index_(false) {
+    SetupDefaultFontManager();
+}
 
 FontCollection::~FontCollection() = default;
 
@@ -88,17 +87,80 @@ void FontCollection::DisableFontFallback() {
     enable_font_fallback_ = false;
 }
 
+void FontCollection::EnableFallbackIndex() {
+    use_fallback_index_ = true;
+}
+
 std::shared_ptr<minikin::FontCollection>
 FontCollection::GetMinikinFontCollectionForFamilies(
         const std::vector<std::string>& font_families,
         const std::string& locale) {
+    return GetMinikinFontCollectionForKey(
+            {InternFontFamilies(font_families), InternLocale(locale)});
+}
+
+std::shared_ptr<minikin::FontCollection>
+FontCollection::GetMinikinFontCollectionForStyle(const TextStyle& style) {
+    if (style.font_families_id == 0) {
+        return GetMinikinFontCollectionForFamilies(style.font_families,
+                                                   style.locale);
+    }
+    return GetMinikinFontCollectionForKey(
+            {style.font_families_id, style.locale_id});
+}
+
+uint32_t FontCollection::NormalizeLocaleId(uint32_t locale_id) {
+    auto normalized = normalized_locale_ids_.find(locale_id);
+    if (normalized != normalized_locale_ids_.end()) {
+        return normalized->second;
+    }
+
+    // Only the first language of the locale is used to pick fallback fonts.
+    std::string locale;
+    const std::string& locale_list = GetInternedLocale(locale_id);
+    if (!locale_list.empty()) {
+        uint32_t language_list_id =
+                minikin::FontStyle::registerLanguageList(locale_list);
+        const minikin::FontLanguages& langs =
+                minikin::FontLanguageListCache::getById(language_list_id);
+        if (langs.size()) {
+            locale = langs[0].getString();
+        }
+    }
+    uint32_t normalized_id = InternLocale(locale);
+    normalized_locale_ids_[locale_id] = normalized_id;
+    return normalized_id;
+}
+
+std::shared_ptr<minikin::FontCollection>
+FontCollection::GetMinikinFontCollectionForKey(const FamilyKey& style_key) {
+    // Styles whose locales share a first language share a collection.
+    const FamilyKey family_key = {style_key.font_families_id,
+                                  NormalizeLocaleId(style_key.locale_id)};
+
     // Look inside the font collections cache first.
-    FamilyKey family_key(font_families, locale);
     auto cached = font_collections_cache_.find(family_key);
     if (cached != font_collections_cache_.end()) {
         return cached->second;
     }
 
+    const std::string& locale = GetInternedLocale(family_key.locale_id);
+    auto font_collection = CreateMinikinFontCollection(
+            GetInternedFontFamilies(family_key.font_families_id), locale);
+    if (!font_collection) {
+        return nullptr;
+    }
+
+    // Cache the font collection for future queries.
+    font_collections_cache_[family_key] = font_collection;
+
+    return font_collection;
+}
+
+std::shared_ptr<minikin::FontCollection>
+FontCollection::CreateMinikinFontCollection(
+        const std::vector<std::string>& font_families,
+        const std::string& locale) {
     std::vector<std::shared_ptr<minikin::FontFamily>> minikin_families;
 
     // Search for all user provided font families.
@@ -139,9 +201,6 @@ FontCollection::GetMinikinFontCollectionForFamilies(
                 std::make_unique<TxtFallbackFontProvider>(shared_from_this()));
     }
 
-    // Cache the font collection for future queries.
-    font_collections_cache_[family_key] = font_collection;
-
     return font_collection;
 }
 
@@ -189,19 +248,42 @@ const std::shared_ptr<minikin::FontFamily>& FontCollection::MatchFallbackFont(
     // Check if the ch's matched font has been cached. We cache the results of
     // this method as repeated matchFamilyStyleCharacter calls can become
     // extremely laggy when typing a large number of complex emojis.
-    auto lookup = fallback_match_cache_.find(ch);
-    if (lookup != fallback_match_cache_.end()) {
-        return *lookup->second;
-    }
     const std::shared_ptr<minikin::FontFamily>* match =
-            &DoMatchFallbackFont(ch, locale);
-    fallback_match_cache_.insert(std::make_pair(ch, match));
+            fallback_match_cache_.Find(ch, locale);
+    if (match) {
+        return *match;
+    }
+    std::lock_guard<std::mutex> lock(fallback_mutex_);
+    // Another thread may have matched it while this one was waiting.
+    match = fallback_match_cache_.Find(ch, locale);
+    if (match) {
+        return *match;
+    }
+    match = &DoMatchFallbackFont(ch, locale);
+    fallback_match_cache_.Insert(ch, locale, match);
     return *match;
 }
 
+FallbackMatchCache::Stats FontCollection::GetFallbackMatchCacheStats() const {
+    return fallback_match_cache_.GetStats();
+}
+
 const std::shared_ptr<minikin::FontFamily>& FontCollection::DoMatchFallbackFont(
         uint32_t ch,
         std::string locale) {
+    if (use_fallback_index_) {
+        std::shared_ptr<const FallbackIndex>& index = fallback_indexes_[locale];
+        if (!index) {
+            index = font_manager_->buildFallbackIndex(locale.c_str());
+        }
+        const std::string* family_name = index->find(ch);
+        if (!family_name) {
+            return g_null_family;
+        }
+        fallback_fonts_for_locale_[locale].insert(*family_name);
+        return GetFallbackFontFamily(font_manager_, *family_name);
+    }
+
     std::vector<const char*> bcp47;
     if (!locale.empty()) {
         bcp47.push_back(locale.c_str());
@@ -237,9 +319,11 @@ FontCollection::GetFallbackFontFamily(const FontManager* manager,
     auto insert_it =
             fallback_fonts_.insert(std::make_pair(family_name, minikin_family));
 
-    // Clear the cache to force creation of new font collections that will
-    // include this fallback font.
-    font_collections_cache_.clear();
+    // The cached font collections are kept. They already reach this family
+    // through their fallback font provider for every character none of their
+    // own families supports, which is the only case it is used for. Collections
+    // created from now on list it directly. Rebuilding them all here would give
+    // them new ids and throw away every layout cached for them.
 
     return insert_it.first->second;
 }
@@ -18,11 +18,13 @@
 #define LIB_TXT_SRC_FONT_COLLECTION_H_
 
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <unordered_map>
 #include "../minikin/FontCollection.h"
 #include "../minikin/FontFamily.h"
+#include "fallback_match_cache.h"
 #include "text_style.h"
 #include "FontManager.h"
 
@@ -40,26 +42,39 @@ public:
             const std::vector<std::string>& font_families,
             const std::string& locale);
 
+    // Same as GetMinikinFontCollectionForFamilies, for the families and locale
+    // of the style. When the style is interned (see TextStyle::Intern) and its
+    // collection is cached, this is a single integer keyed lookup.
+    std::shared_ptr<minikin::FontCollection> GetMinikinFontCollectionForStyle(
+            const TextStyle& style);
+
     // Provides a FontFamily that contains glyphs for ch. This caches previously
-    // matched fonts. Also see FontCollection::DoMatchFallbackFont.
+    // matched fonts per locale, and may be called from several threads. Also see
+    // FontCollection::DoMatchFallbackFont.
     const std::shared_ptr<minikin::FontFamily>& MatchFallbackFont(
             uint32_t ch,
             std::string locale);
 
+    FallbackMatchCache::Stats GetFallbackMatchCacheStats() const;
+
     // Do not provide alternative fonts that can match characters which are
     // missing from the requested font family.
     void DisableFontFallback();
 
+    // Resolve fallback fonts through a FallbackIndex built from the charsets of
+    // all installed fonts, instead of a fontconfig match per character. The
+    // index of a locale is built on its first fallback lookup, which takes a
+    // while, and every later miss is a table lookup.
+    void EnableFallbackIndex();
+
     // Remove all entries in the font family cache.
     void ClearFontFamilyCache();
 
 private:
     struct FamilyKey {
-        FamilyKey(const std::vector<std::string>& families, const std::string& loc);
-
-        // Concatenated string with all font families.
-        std::string font_families;
-        std::string locale;
+        // Interned ids of the font families and locale.
+        uint32_t font_families_id;
+        uint32_t locale_id;
 
         bool operator==(const FamilyKey& other) const;
 
@@ -68,20 +83,40 @@ private:
         };
     };
 
+    std::shared_ptr<minikin::FontCollection> GetMinikinFontCollectionForKey(
+            const FamilyKey& style_key);
+
+    // Returns the interned id of the first language of the locale with the
+    // given id, which is all that picking fonts depends on.
+    uint32_t NormalizeLocaleId(uint32_t locale_id);
+
+    std::shared_ptr<minikin::FontCollection> CreateMinikinFontCollection(
+            const std::vector<std::string>& font_families,
+            const std::string& locale);
+
     FontManager* font_manager_;
     std::unordered_map<FamilyKey,
             std::shared_ptr<minikin::FontCollection>,
             FamilyKey::Hasher>
             font_collections_cache_;
+    // Interned locale id to the id of its normalized first language, so that
+    // locale lists that pick the same fonts share one collection.
+    std::unordered_map<uint32_t, uint32_t> normalized_locale_ids_;
     // Cache that stores the results of MatchFallbackFont to ensure lag-free emoji
-    // font fallback matching.
-    std::unordered_map<uint32_t, const std::shared_ptr<minikin::FontFamily>*>
-            fallback_match_cache_;
+    // font fallback matching. It points into fallback_fonts_, whose entries are
+    // never erased, so the pointers stay valid.
+    FallbackMatchCache fallback_match_cache_;
+    // Serializes the misses of fallback_match_cache_, which update the fallback
+    // maps below.
+    std::mutex fallback_mutex_;
     std::unordered_map<std::string, std::shared_ptr<minikin::FontFamily>>
             fallback_fonts_;
     std::unordered_map<std::string, std::set<std::string>>
             fallback_fonts_for_locale_;
     bool enable_font_fallback_;
+    bool use_fallback_index_;
+    std::unordered_map<std::string, std::shared_ptr<const FallbackIndex>>
+            fallback_indexes_;
 
     // Performs the actual work of MatchFallbackFont. The result is cached in
     // fallback_match_cache_.
@@ -23,14 +23,15 @@
 #include <stb/stb_image.h>
 
 #include "GLRenderer.h"
-#include "paragraph_builder.h"
 #include "paint_record.h"
+#include "text_view.h"
 #include "TextRenderer.h"
+#include "unicode/utf16.h"
 
 // settings
 const unsigned int SCR_WIDTH = 1000;
 const unsigned int SCR_HEIGHT = 600;
-std::string inputChars;
+std::u16string inputChars;
 
 void window_pos_callback(GLFWwindow* window, int xpos, int ypos) {
     int width, height;
@@ -50,7 +51,13 @@ void processInput(GLFWwindow* window) {
 }
 
 void character_callback(GLFWwindow* window, unsigned int codepoint) {
-    inputChars += (char) codepoint;
+    // GLFW reports code points, the paragraph takes UTF-16
+    if (U_IS_BMP(codepoint)) {
+        inputChars += static_cast<char16_t>(codepoint);
+    } else {
+        inputChars += static_cast<char16_t>(U16_LEAD(codepoint));
+        inputChars += static_cast<char16_t>(U16_TRAIL(codepoint));
+    }
 }
 
 
@@ -111,6 +118,37 @@ int main() {
     double deltaTime = 0;
     std::shared_ptr<txt::FontCollection> fCollection = std::make_shared<txt::FontCollection>();
     // fCollection->DisableFontFallback();
+
+    txt::ParagraphStyle style;
+    style.max_lines = 13;
+
+    txt::TextStyle ts;
+    ts.font_size = 50;
+    ts.word_spacing = 20;
+    // ts.letter_spacing = 5;
+    // ts.height = 1.5;
+    // ts.font_families.emplace_back("Verdana");
+    // ts.font_families.emplace_back("Helvetica");
+    // ts.font_families.emplace_back("STHeiti");
+    txt::TextStyle italic = ts;
+    italic.font_style = txt::FontItalic::italic;
+
+    // The paragraph is only rebuilt when the typed text changes; other frames
+    // just paint the records of the last layout.
+    txt::TextView textView(fCollection);
+    textView.SetParagraphStyle(style);
+    textView.SetWidth(500);
+    std::u16string shownChars;
+    auto setSpans = [&]() {
+        txt::TextStyle base = style.GetTextStyle();
+        textView.SetSpans({
+                {u"好", base},
+                {u"Hello World ParagraphBuilder\n", italic},
+                {u"好12345\n", base},
+                {shownChars, ts},
+        });
+    };
+    setSpans();
     while (!glfwWindowShouldClose(window)) {
         processInput(window);
 
@@ -130,36 +168,12 @@ int main() {
             printf("fps %f \n", 1.0 / (time - lastTime));
         }
 
-        txt::ParagraphStyle style;
-        style.max_lines = 13;
-        auto paragraphBuilder = std::make_unique<txt::ParagraphBuilder>(
-                style, fCollection);
-
-        txt::TextStyle ts;
-        ts.font_size = 50;
-        ts.word_spacing = 20;
-        // ts.letter_spacing = 5;
-        // ts.height = 1.5;
-        // ts.font_families.emplace_back("Verdana");
-        // ts.font_families.emplace_back("Helvetica");
-        // ts.font_families.emplace_back("STHeiti");
-        paragraphBuilder->AddText("好");
-        ts.font_style = txt::FontItalic::italic;
-        paragraphBuilder->PushStyle(ts);
-        paragraphBuilder->AddText("Hello World ParagraphBuilder\n");
-        paragraphBuilder->Pop();
-        paragraphBuilder->AddText("好12345\n");
-        // ts.font_size = 50;
-        // ts.font_weight = txt::FontWeight::w100;
-        // ts.font_style = txt::FontItalic::italic;
-        // paragraphBuilder->PushStyle(ts);
-        // paragraphBuilder->AddText("好12345\n");
-        // paragraphBuilder->AddText(inputChars);
-
-        auto paragraph = paragraphBuilder->Build();
-
-        paragraph->Layout(500);
-        paragraph->Paint(&tr, 10, 20);
+        if (shownChars != inputChars) {
+            shownChars = inputChars;
+            setSpans();
+        }
+
+        textView.Paint(&tr, 10, 20);
 
         // fr.renderPosText("你\n好12345", "30px 苹方-简", 10, 10, 100);
         // fr.renderPosText("你\n好12345", "50px sans-serif", 10, 10);
@@ -69,19 +69,28 @@ GlyphTypeface GetGlyphTypeface(const minikin::Layout& layout, size_t index) {
     return GlyphTypeface(font->typeface(), layout.getFakery(index));
 }
 
+GlyphTypeface GetFontRunTypeface(const minikin::Layout& layout, size_t run) {
+    const LayoutFont* font =
+            static_cast<const LayoutFont*>(layout.getFontRunFont(run));
+    return GlyphTypeface(font->typeface(), layout.getFontRunFakery(run));
+}
+
 // Return ranges of text that have the same typeface in the layout.
 std::vector<Paragraph::Range<size_t>> GetLayoutTypefaceRuns(
         const minikin::Layout& layout) {
     std::vector<Paragraph::Range<size_t>> result;
     if (layout.nGlyphs() == 0)
         return result;
+    // Font runs of different minikin fonts can still share a typeface, merge
+    // those.
+    GlyphTypeface run_typeface = GetFontRunTypeface(layout, 0);
     size_t run_start = 0;
-    GlyphTypeface run_typeface = GetGlyphTypeface(layout, run_start);
-    for (size_t i = 1; i < layout.nGlyphs(); ++i) {
-        GlyphTypeface typeface = GetGlyphTypeface(layout, i);
+    for (size_t r = 1; r < layout.nFontRuns(); ++r) {
+        GlyphTypeface typeface = GetFontRunTypeface(layout, r);
         if (typeface != run_typeface) {
-            result.emplace_back(run_start, i);
-            run_start = i;
+            size_t start = layout.getFontRunStart(r);
+            result.emplace_back(run_start, start);
+            run_start = start;
             run_typeface = typeface;
         }
     }
@@ -153,6 +162,17 @@ void GetFontAndMinikinPaint(const TextStyle& style,
     paint->paintFlags |= minikin::LinearTextFlag;
 }
 
+// Returns true if offset is one of the boundaries minikin::Layout splits text
+// at before shaping, or is the given run edge.
+bool IsLayoutWordBoundary(const std::vector<uint16_t>& text,
+                          size_t offset,
+                          size_t run_edge) {
+    if (offset == run_edge || offset == 0 || offset >= text.size())
+        return true;
+    return minikin::getPrevWordBreakForCache(text.data(), offset + 1,
+                                             text.size()) == offset;
+}
+
 void FindWords(const std::vector<uint16_t>& text,
                size_t start,
                size_t end,
@@ -224,7 +244,7 @@ void Paragraph::SetText(std::vector<uint16_t> text, StyledRuns runs) {
     runs_ = std::move(runs);
 }
 
-bool Paragraph::ComputeLineBreaks() {
+bool Paragraph::ComputeLineBreaks(bool reuse_measurement) {
     line_ranges_.clear();
     line_widths_.clear();
     max_intrinsic_width_ = 0;
@@ -239,7 +259,15 @@ bool Paragraph::ComputeLineBreaks() {
     }
     newline_positions.push_back(text_.size());
 
+    if (!reuse_measurement) {
+        shaped_runs_.clear();
+        block_widths_.clear();
+        block_widths_.resize(newline_positions.size());
+    }
+    bool isRtl = (paragraph_style_.text_direction == TextDirection::rtl);
+
     size_t run_index = 0;
+    size_t shaped_run_index = 0;
     for (size_t newline_index = 0; newline_index < newline_positions.size();
          ++newline_index) {
         size_t block_start =
@@ -274,33 +302,64 @@ bool Paragraph::ComputeLineBreaks() {
                 continue;
             }
 
-            minikin::FontStyle font;
-            minikin::MinikinPaint paint;
-            GetFontAndMinikinPaint(run.style, &font, &paint);
-            std::shared_ptr<minikin::FontCollection> collection =
-                    GetMinikinFontCollectionForStyle(run.style);
+            ResolvedStyle& resolved = resolved_styles_[run.style_index];
+            const minikin::FontStyle& font = resolved.font;
+            minikin::MinikinPaint& paint = resolved.paint;
+            const std::shared_ptr<minikin::FontCollection>& collection =
+                    resolved.collection;
             if (collection == nullptr) {
                 std::cerr << "Could not find font collection for families \""
                           << (run.style.font_families.empty()
                               ? ""
                               : run.style.font_families[0])
                           << "\".";
+                shaped_runs_.clear();
+                block_widths_.clear();
                 return false;
             }
             // 最小片段
             size_t run_start = std::max(run.start, block_start) - block_start;
             size_t run_end = std::min(run.end, block_end) - block_start;
-            bool isRtl = (paragraph_style_.text_direction == TextDirection::rtl);
-            // 片段宽度
-            double run_width = breaker_.addStyleRun(&paint, collection, font,
-                                                    run_start, run_end, isRtl);
-            block_total_width += run_width;
+            if (run_end > run_start) {
+                // Shape the run once against the whole text, so that line
+                // assembly can slice glyphs out of it, and hand its advances
+                // to the LineBreaker as the char widths.
+                if (!reuse_measurement) {
+                    shaped_runs_.emplace_back(block_start + run_start,
+                                              block_start + run_end, isRtl,
+                                              collection);
+                    ShapedRun& shaped = shaped_runs_.back();
+                    shaped.layout.doLayout(text_.data(), shaped.start,
+                                           shaped.end - shaped.start,
+                                           text_.size(), isRtl, font, paint,
+                                           collection);
+                    std::vector<float> advances(shaped.end - shaped.start);
+                    shaped.layout.getAdvances(advances.data());
+                    shaped.advance_sums.resize(advances.size() + 1);
+                    shaped.advance_sums[0] = 0;
+                    for (size_t i = 0; i < advances.size(); i++) {
+                        shaped.advance_sums[i + 1] =
+                                shaped.advance_sums[i] + advances[i];
+                    }
+                    // 片段宽度
+                    block_total_width += shaped.layout.getAdvance();
+                }
+                ShapedRun& shaped = shaped_runs_[shaped_run_index++];
+                shaped.layout.getAdvances(breaker_.charWidths() + run_start);
+            }
+            breaker_.addMeasuredStyleRun(&paint, collection, font, run_start,
+                                         run_end, isRtl);
 
             if (run.end > block_end)
                 break; // style run 当前 line 之后跳出
             run_index++;
         }
 
+        if (reuse_measurement) {
+            block_total_width = block_widths_[newline_index];
+        } else {
+            block_widths_[newline_index] = block_total_width;
+        }
         max_intrinsic_width_ = std::max(max_intrinsic_width_, block_total_width);
 
         size_t breaks_count = breaker_.computeBreaks();
@@ -403,7 +462,7 @@ bool Paragraph::ComputeBidiRuns(std::vector<BidiRun>* result) {
             const StyledRuns::Run& styled_run = styled_run_iter->second;
             size_t chunk_end = std::min(bidi_run_end, styled_run.end);
             chunks.emplace_back(chunk_start, chunk_end, text_direction,
-                                styled_run.style);
+                                styled_run.style, styled_run.style_index);
             chunk_start = chunk_end;
         }
 
@@ -449,16 +508,16 @@ void Paragraph::ComputeStrut(StrutMetrics* strut) {
     if (faked_font.font != nullptr) {
         LayoutFont* font = static_cast<LayoutFont*>(faked_font.font);
         Typeface* typeface = font->typeface();
-        typeface->setSize(paragraph_style_.strut_font_size);
+        uint strut_size = paragraph_style_.strut_font_size;
 
-        strut->ascent = paragraph_style_.strut_height * -typeface->ascent();
-        strut->descent = paragraph_style_.strut_height * typeface->descent();
+        strut->ascent = paragraph_style_.strut_height * -typeface->ascent(strut_size);
+        strut->descent = paragraph_style_.strut_height * typeface->descent(strut_size);
         strut->leading =
                 // Use font's leading if there is no user specified strut leading.
                 paragraph_style_.strut_leading < 0
-                ? typeface->leading()
+                ? typeface->leading(strut_size)
                 : (paragraph_style_.strut_leading *
-                   (typeface->descent() - typeface->ascent()));
+                   (typeface->descent(strut_size) - typeface->ascent(strut_size)));
         strut->half_leading = strut->leading / 2;
         strut->line_height = strut->ascent + strut->descent + strut->leading;
     }
@@ -469,11 +528,17 @@ void Paragraph::Layout(double width, bool force) {
     if (!needs_layout_ && width == width_ && !force) {
         return;
     }
+    // Nothing but the width changed since the last layout, so the text does
+    // not need to be measured again.
+    bool reuse_measurement =
+            !needs_layout_ && !force && !block_widths_.empty();
     needs_layout_ = false;
 
     width_ = floor(width);
 
-    if (!ComputeLineBreaks())
+    ResolveStyles();
+
+    if (!ComputeLineBreaks(reuse_measurement))
         return;
 
     std::vector<BidiRun> bidi_runs;
@@ -490,6 +555,7 @@ void Paragraph::Layout(double width, bool force) {
     max_right_ = FLT_MIN;
     min_left_ = FLT_MAX;
     records_.clear();
+    text_mesh_.invalidate();
 
     minikin::Layout layout;
     double y_offset = 0;
@@ -538,7 +604,8 @@ void Paragraph::Layout(double width, bool force) {
                 bidi_run.end() > line_range.start) {
                 line_runs.emplace_back(std::max(bidi_run.start(), line_range.start),
                                        std::min(bidi_run.end(), line_end_index),
-                                       bidi_run.direction(), bidi_run.style());
+                                       bidi_run.direction(), bidi_run.style(),
+                                       bidi_run.style_index());
             }
             // A "ghost" run is a run that does not impact the layout, breaking,
             // alignment, width, etc but is still "visible" though getRectsForRange.
@@ -555,7 +622,8 @@ void Paragraph::Layout(double width, bool force) {
                 bidi_run.end() > line_end_index) {
                 line_runs.emplace_back(std::max(bidi_run.start(), line_end_index),
                                        std::min(bidi_run.end(), line_range.end),
-                                       bidi_run.direction(), bidi_run.style(), true);
+                                       bidi_run.direction(), bidi_run.style(),
+                                       bidi_run.style_index(), true);
             }
         }
 
@@ -577,12 +645,11 @@ void Paragraph::Layout(double width, bool force) {
         for (auto line_run_it = line_runs.begin(); line_run_it != line_runs.end();
              ++line_run_it) {
             const BidiRun& run = *line_run_it;
-            minikin::FontStyle minikin_font;
-            minikin::MinikinPaint minikin_paint;
-            GetFontAndMinikinPaint(run.style(), &minikin_font, &minikin_paint);
-
-            std::shared_ptr<minikin::FontCollection> minikin_font_collection =
-                    GetMinikinFontCollectionForStyle(run.style());
+            const ResolvedStyle& resolved = resolved_styles_[run.style_index()];
+            const minikin::FontStyle& minikin_font = resolved.font;
+            const minikin::MinikinPaint& minikin_paint = resolved.paint;
+            const std::shared_ptr<minikin::FontCollection>& minikin_font_collection =
+                    resolved.collection;
 
             // Layout this run.
             uint16_t* text_ptr = text_.data();
@@ -590,8 +657,22 @@ void Paragraph::Layout(double width, bool force) {
             size_t text_count = run.end() - run.start();
             size_t text_size = text_.size();
 
-            layout.doLayout(text_ptr, text_start, text_count, text_size, run.is_rtl(),
-                            minikin_font, minikin_paint, minikin_font_collection);
+            // Reuse the glyphs shaped during line breaking when this run can
+            // be cut out of one of the shaped runs unchanged.
+            const ShapedRun* shaped = FindShapedRun(run);
+            if (shaped != nullptr) {
+                size_t slice_start = text_start - shaped->start;
+                size_t slice_end = slice_start + text_count;
+                float offset = run.is_rtl()
+                        ? shaped->advance_sums.back() - shaped->advance_sums[slice_end]
+                        : shaped->advance_sums[slice_start];
+                layout.extractLayout(shaped->layout, slice_start, text_count,
+                                     run.is_rtl(), offset);
+            } else {
+                layout.doLayout(text_ptr, text_start, text_count, text_size,
+                                run.is_rtl(), minikin_font, minikin_paint,
+                                minikin_font_collection);
+            }
 
             if (layout.nGlyphs() == 0)
                 continue;
@@ -610,7 +691,6 @@ void Paragraph::Layout(double width, bool force) {
                 std::vector<GlyphPosition> glyph_positions;
 
                 Typeface* typeface = GetGlyphTypeface(layout, glyph_blob.start).typeface();
-                typeface->setSize(run.style().font_size);
 
                 std::unique_ptr<RunBuffer> blob_buffer = std::make_unique<RunBuffer>();
                 blob_buffer->typeface = typeface;
@@ -728,7 +808,7 @@ void Paragraph::Layout(double width, bool force) {
                 if (glyph_positions.empty())
                     continue;
                 FontMetrics metrics;
-                typeface->getMetrics(&metrics);
+                typeface->getMetrics(run.style().font_size, &metrics);
 
                 Range<double> record_x_pos(
                         glyph_positions.front().x_pos.start - run_x_offset,
@@ -817,8 +897,7 @@ void Paragraph::Layout(double width, bool force) {
             FontMetrics metrics;
             TextStyle style(paragraph_style_.GetTextStyle());
             Typeface* typeface = GetDefaultTypeface(style);
-            typeface->setSize(style.font_size);
-            typeface->getMetrics(&metrics);
+            typeface->getMetrics(style.font_size, &metrics);
             update_line_metrics(metrics, style);
         }
 
@@ -863,6 +942,25 @@ void Paragraph::Layout(double width, bool force) {
               });
 }
 
+const Paragraph::ShapedRun* Paragraph::FindShapedRun(const BidiRun& run) const {
+    auto it = std::upper_bound(
+            shaped_runs_.begin(), shaped_runs_.end(), run.start(),
+            [](size_t start, const ShapedRun& shaped) {
+                return start < shaped.start;
+            });
+    if (it == shaped_runs_.begin())
+        return nullptr;
+    const ShapedRun& shaped = *(--it);
+    if (run.end() > shaped.end || run.is_rtl() != shaped.is_rtl)
+        return nullptr;
+    // The layout is assembled word by word, so a slice only matches shaping
+    // the run on its own when it starts and ends on the same word boundaries.
+    if (!IsLayoutWordBoundary(text_, run.start(), shaped.start) ||
+        !IsLayoutWordBoundary(text_, run.end(), shaped.end))
+        return nullptr;
+    return &shaped;
+}
+
 double Paragraph::GetLineXOffset(double line_total_advance) {
     if (isinf(width_))
         return 0;
@@ -922,21 +1020,20 @@ void Paragraph::SetFontCollection(
     font_collection_ = std::move(font_collection);
 }
 
-std::shared_ptr<minikin::FontCollection>
-Paragraph::GetMinikinFontCollectionForStyle(const TextStyle& style) {
-    std::string locale;
-    if (!style.locale.empty()) {
-        uint32_t language_list_id =
-                minikin::FontStyle::registerLanguageList(style.locale);
-        const minikin::FontLanguages& langs =
-                minikin::FontLanguageListCache::getById(language_list_id);
-        if (langs.size()) {
-            locale = langs[0].getString();
-        }
+void Paragraph::ResolveStyles() {
+    resolved_styles_.resize(runs_.style_count());
+    for (size_t i = 0; i < resolved_styles_.size(); ++i) {
+        const TextStyle& style = runs_.GetStyle(i);
+        ResolvedStyle& resolved = resolved_styles_[i];
+        resolved.paint = minikin::MinikinPaint();
+        GetFontAndMinikinPaint(style, &resolved.font, &resolved.paint);
+        resolved.collection = GetMinikinFontCollectionForStyle(style);
     }
+}
 
-    return font_collection_->GetMinikinFontCollectionForFamilies(
-            style.font_families, locale);
+std::shared_ptr<minikin::FontCollection>
+Paragraph::GetMinikinFontCollectionForStyle(const TextStyle& style) {
+    return font_collection_->GetMinikinFontCollectionForStyle(style);
 }
 
 Typeface* Paragraph::GetDefaultTypeface(const TextStyle& style) {
@@ -1045,11 +1142,7 @@ void Paragraph::SetDirty(bool dirty) {
 }
 
 void Paragraph::Paint(TextRenderer* renderer, double x, double y) {
-    for (const PaintRecord& record : records_) {
-        double offset_x = x + record.offset_x();
-        double offset_y = y + record.offset_y();
-        renderer->drawTextBlob(record.buffer(), offset_x, offset_y, record.style());
-    }
+    renderer->drawTextMesh(records_, &text_mesh_, x, y);
 }
 
 }  // namespace txt
@@ -21,6 +21,7 @@
 #include <utility>
 #include <vector>
 
+#include "../minikin/Layout.h"
 #include "../minikin/LineBreaker.h"
 #include "paragraph_style.h"
 #include "styled_runs.h"
@@ -215,7 +216,46 @@ private:
     std::vector<LineRange> line_ranges_;
     std::vector<double> line_widths_;
 
+    // A style run within one newline-delimited block, shaped once while
+    // computing line breaks. Its advances feed the LineBreaker and its glyphs
+    // are sliced into lines afterwards, so the text is not shaped twice. They
+    // are kept across layouts so that a Layout() that only changes the width
+    // can go straight to line breaking.
+    struct ShapedRun {
+        ShapedRun(size_t s,
+                  size_t e,
+                  bool rtl,
+                  std::shared_ptr<minikin::FontCollection> c)
+                : start(s), end(e), is_rtl(rtl), collection(std::move(c)) {}
+
+        size_t start, end;
+        bool is_rtl;
+        // Keeps the fonts referenced by the layout alive.
+        std::shared_ptr<minikin::FontCollection> collection;
+        minikin::Layout layout;
+        // advance_sums[i] is the sum of the advances of the first i code units,
+        // so that slices find their offset in constant time.
+        std::vector<float> advance_sums;
+    };
+    // Sorted by start.
+    std::vector<ShapedRun> shaped_runs_;
+
+    // What a style of runs_ resolves to for minikin. Computed once per layout
+    // for every style, and looked up by style index for each run.
+    struct ResolvedStyle {
+        minikin::FontStyle font;
+        minikin::MinikinPaint paint;
+        std::shared_ptr<minikin::FontCollection> collection;
+    };
+    // Indexed like the styles of runs_.
+    std::vector<ResolvedStyle> resolved_styles_;
+    // The unbroken width of each newline-delimited block.
+    std::vector<double> block_widths_;
+
     std::vector<PaintRecord> records_;
+    // GPU copy of the glyph quads of records_, reused by Paint() until the next
+    // layout.
+    TextMesh text_mesh_;
 
     std::vector<double> line_heights_;
     std::vector<double> line_baselines_;
@@ -233,16 +273,23 @@ private:
     class BidiRun {
     public:
         // Constructs a BidiRun with is_ghost defaulted to false.
-        BidiRun(size_t s, size_t e, TextDirection d, const TextStyle& st)
-                : start_(s), end_(e), direction_(d), style_(&st), is_ghost_(false) {}
+        BidiRun(size_t s,
+                size_t e,
+                TextDirection d,
+                const TextStyle& st,
+                size_t style_index)
+                : start_(s), end_(e), direction_(d), style_(&st),
+                  style_index_(style_index), is_ghost_(false) {}
 
         // Constructs a BidiRun with a custom is_ghost flag.
         BidiRun(size_t s,
                 size_t e,
                 TextDirection d,
                 const TextStyle& st,
+                size_t style_index,
                 bool is_ghost)
-                : start_(s), end_(e), direction_(d), style_(&st), is_ghost_(is_ghost) {}
+                : start_(s), end_(e), direction_(d), style_(&st),
+                  style_index_(style_index), is_ghost_(is_ghost) {}
 
         size_t start() const { return start_; }
 
@@ -252,6 +299,9 @@ private:
 
         const TextStyle& style() const { return *style_; }
 
+        // Index of the style in the paragraph's StyledRuns.
+        size_t style_index() const { return style_index_; }
+
         bool is_rtl() const { return direction_ == TextDirection::rtl; }
 
         // Tracks if the run represents trailing whitespace.
@@ -261,6 +311,7 @@ private:
         size_t start_, end_;
         TextDirection direction_;
         const TextStyle* style_;
+        size_t style_index_;
         bool is_ghost_;
     };
 
@@ -348,12 +399,20 @@ private:
 
     void SetFontCollection(std::shared_ptr<FontCollection> font_collection);
 
-    // Break the text into lines.
-    bool ComputeLineBreaks();
+    // Fills resolved_styles_ from the styles of runs_.
+    void ResolveStyles();
+
+    // Break the text into lines. When reuse_measurement is true, the runs in
+    // shaped_runs_ are used instead of shaping the text again.
+    bool ComputeLineBreaks(bool reuse_measurement);
 
     // Break the text into runs based on LTR/RTL text direction.
     bool ComputeBidiRuns(std::vector<BidiRun>* result);
 
+    // Returns the shaped run that the glyphs of the given run can be sliced
+    // from, or nullptr if the run has to be shaped on its own.
+    const ShapedRun* FindShapedRun(const BidiRun& run) const;
+
     void ComputeStrut(StrutMetrics* strut);
 
     // Calculate the starting X offset of a line based on the line's width and
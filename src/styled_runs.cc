@@ -41,6 +41,8 @@ void StyledRuns::swap(StyledRuns& other) {
 size_t StyledRuns::AddStyle(const TextStyle& style) {
     const size_t style_index = styles_.size();
     styles_.push_back(style);
+    // Styles are not modified once added, so their ids stay valid.
+    styles_.back().Intern();
     return style_index;
 }
 
@@ -67,7 +69,7 @@ void StyledRuns::EndRunIfNeeded(size_t end) {
 
 StyledRuns::Run StyledRuns::GetRun(size_t index) const {
     const IndexedRun& run = runs_[index];
-    return Run{styles_[run.style_index], run.start, run.end};
+    return Run{styles_[run.style_index], run.start, run.end, run.style_index};
 }
 
 }  // namespace txt
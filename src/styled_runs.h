@@ -32,6 +32,7 @@ public:
         const TextStyle& style;
         size_t start;
         size_t end;
+        size_t style_index;
     };
 
     StyledRuns();
@@ -50,6 +51,8 @@ public:
 
     const TextStyle& GetStyle(size_t style_index) const;
 
+    size_t style_count() const { return styles_.size(); }
+
     void StartRun(size_t style_index, size_t start);
 
     void EndRunIfNeeded(size_t end);
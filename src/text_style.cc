@@ -15,10 +15,85 @@
  */
 
 #include "text_style.h"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
 #include "platform.h"
 
 namespace txt {
 
+namespace {
+
+// Maps strings to dense ids. The values live in a deque so that references
+// returned by Get() stay valid while other threads intern more of them.
+template <typename T>
+class Interner {
+public:
+    explicit Interner(uint32_t first_id) : first_id_(first_id) {}
+
+    uint32_t Intern(const std::string& key, const T& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = ids_.find(key);
+        if (it != ids_.end())
+            return it->second;
+        uint32_t id = first_id_ + values_.size();
+        values_.push_back(value);
+        ids_.emplace(key, id);
+        return id;
+    }
+
+    const T& Get(uint32_t id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return values_[id - first_id_];
+    }
+
+private:
+    const uint32_t first_id_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, uint32_t> ids_;
+    std::deque<T> values_;
+};
+
+Interner<std::vector<std::string>>& FontFamiliesInterner() {
+    static Interner<std::vector<std::string>> interner(1);
+    return interner;
+}
+
+Interner<std::string>& LocaleInterner() {
+    static Interner<std::string> interner(1);
+    return interner;
+}
+
+const std::string g_empty_locale;
+
+}  // anonymous namespace
+
+uint32_t InternFontFamilies(const std::vector<std::string>& font_families) {
+    std::string key;
+    for (const std::string& family : font_families) {
+        key.append(family);
+        key.push_back(',');
+    }
+    return FontFamiliesInterner().Intern(key, font_families);
+}
+
+uint32_t InternLocale(const std::string& locale) {
+    if (locale.empty())
+        return 0;
+    return LocaleInterner().Intern(locale, locale);
+}
+
+const std::vector<std::string>& GetInternedFontFamilies(uint32_t id) {
+    return FontFamiliesInterner().Get(id);
+}
+
+const std::string& GetInternedLocale(uint32_t id) {
+    if (id == 0)
+        return g_empty_locale;
+    return LocaleInterner().Get(id);
+}
+
 TextStyle::TextStyle()
         : font_families(std::vector<std::string>(1, GetDefaultFontFamily())) {}
 
@@ -29,6 +104,8 @@ bool TextStyle::equals(const TextStyle& other) const {
         return false;
     if (font_style != other.font_style)
         return false;
+    if (font_size != other.font_size)
+        return false;
     if (letter_spacing != other.letter_spacing)
         return false;
     if (word_spacing != other.word_spacing)
@@ -37,6 +114,8 @@ bool TextStyle::equals(const TextStyle& other) const {
         return false;
     if (locale != other.locale)
         return false;
+    if (font_families.size() != other.font_families.size())
+        return false;
     for (size_t font_index = 0; font_index < font_families.size(); ++font_index) {
         if (font_families[font_index] != other.font_families[font_index])
             return false;
@@ -45,4 +124,9 @@ bool TextStyle::equals(const TextStyle& other) const {
     return true;
 }
 
+void TextStyle::Intern() {
+    font_families_id = InternFontFamilies(font_families);
+    locale_id = InternLocale(locale);
+}
+
 }  // namespace txt
@@ -17,10 +17,23 @@
 #ifndef LIB_TXT_SRC_TEXT_STYLE_H_
 #define LIB_TXT_SRC_TEXT_STYLE_H_
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
 namespace txt {
+
+// Returns a small id for the list of font families. Equal lists get the same
+// id, and ids are never reused. Safe to call from any thread.
+uint32_t InternFontFamilies(const std::vector<std::string>& font_families);
+
+// Same as InternFontFamilies, for a locale. The empty locale is always 0.
+uint32_t InternLocale(const std::string& locale);
+
+const std::vector<std::string>& GetInternedFontFamilies(uint32_t id);
+
+const std::string& GetInternedLocale(uint32_t id);
+
 enum class FontItalic {
     normal,
     italic,
@@ -53,10 +66,18 @@ public:
     double word_spacing = 0.0;
     double height = 1.0;
     std::string locale;
+    // Interned ids of font_families and locale, set by Intern(). The families
+    // id is 0 until then. They are not updated when the fields above change.
+    uint32_t font_families_id = 0;
+    uint32_t locale_id = 0;
 
     TextStyle();
 
     bool equals(const TextStyle& other) const;
+
+    // Interns font_families and locale, so that looking up the font collection
+    // of the style does not need to compare or hash strings.
+    void Intern();
 };
 
 }  // namespace txt
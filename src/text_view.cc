@@ -0,0 +1,74 @@
+/*
+ * Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "text_view.h"
+
+#include <utility>
+
+#include "paragraph_builder.h"
+
+namespace txt {
+
+bool TextView::Span::operator==(const Span& other) const {
+    return text == other.text && style.equals(other.style);
+}
+
+TextView::TextView(std::shared_ptr<FontCollection> font_collection)
+        : font_collection_(std::move(font_collection)) {}
+
+TextView::~TextView() = default;
+
+void TextView::SetSpans(std::vector<Span> spans) {
+    if (spans == spans_)
+        return;
+    spans_ = std::move(spans);
+    needs_build_ = true;
+}
+
+void TextView::SetParagraphStyle(const ParagraphStyle& style) {
+    paragraph_style_ = style;
+    needs_build_ = true;
+}
+
+void TextView::SetWidth(double width) {
+    width_ = width;
+}
+
+void TextView::SetDirty() {
+    needs_build_ = true;
+}
+
+Paragraph* TextView::Layout() {
+    if (needs_build_ || !paragraph_) {
+        ParagraphBuilder builder(paragraph_style_, font_collection_);
+        for (const Span& span : spans_) {
+            builder.PushStyle(span.style);
+            builder.AddText(span.text);
+            builder.Pop();
+        }
+        paragraph_ = builder.Build();
+        needs_build_ = false;
+    }
+    // Returns right away when neither the paragraph nor the width changed.
+    paragraph_->Layout(width_);
+    return paragraph_.get();
+}
+
+void TextView::Paint(TextRenderer* renderer, double x, double y) {
+    Layout()->Paint(renderer, x, y);
+}
+
+}  // namespace txt
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2017 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIB_TXT_SRC_TEXT_VIEW_H_
+#define LIB_TXT_SRC_TEXT_VIEW_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "font_collection.h"
+#include "paragraph.h"
+#include "paragraph_style.h"
+#include "text_style.h"
+#include "TextRenderer.h"
+
+namespace txt {
+
+// TextView is a retained text node. It owns a Paragraph built from its spans
+// and only rebuilds or lays it out again when the spans, the paragraph style
+// or the width change. Painting an unchanged view just replays the paint
+// records of the existing layout:
+//
+//   txt::TextView view(font_collection);
+//   view.SetWidth(500);
+//   view.SetSpans({{u"Hello ", normal_style}, {u"World", bold_style}});
+//   ...
+//   // Every frame:
+//   view.Paint(&renderer, x, y);
+class TextView {
+public:
+    // A piece of text drawn with a single style.
+    struct Span {
+        std::u16string text;
+        TextStyle style;
+
+        bool operator==(const Span& other) const;
+
+        bool operator!=(const Span& other) const { return !(*this == other); }
+    };
+
+    explicit TextView(std::shared_ptr<FontCollection> font_collection);
+
+    ~TextView();
+
+    // Replaces the content of the view. Does nothing if the spans are the same
+    // as the current ones.
+    void SetSpans(std::vector<Span> spans);
+
+    const std::vector<Span>& spans() const { return spans_; }
+
+    void SetParagraphStyle(const ParagraphStyle& style);
+
+    const ParagraphStyle& GetParagraphStyle() const { return paragraph_style_; }
+
+    // Sets the width the paragraph is laid out to. A width-only change skips
+    // rebuilding the paragraph and reuses its shaping results.
+    void SetWidth(double width);
+
+    double GetWidth() const { return width_; }
+
+    // Forces the paragraph to be rebuilt on the next Layout(), for example
+    // after fonts were added to the font collection.
+    void SetDirty();
+
+    // Builds and lays out the paragraph if anything changed since the last
+    // call. Returns the up to date paragraph, which stays owned by the view.
+    Paragraph* Layout();
+
+    // Lays out if needed and paints the paragraph at (x, y).
+    void Paint(TextRenderer* renderer, double x, double y);
+
+private:
+    std::shared_ptr<FontCollection> font_collection_;
+    ParagraphStyle paragraph_style_;
+    std::vector<Span> spans_;
+    double width_ = 0;
+
+    std::unique_ptr<Paragraph> paragraph_;
+    bool needs_build_ = true;
+};
+
+}  // namespace txt
+
+#endif  // LIB_TXT_SRC_TEXT_VIEW_H_